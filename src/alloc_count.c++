@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "alloc_count.h++"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+/* Allocations are only counted once someone has asked for them,
+ * which keeps the common case down to a single load of a flag that
+ * never changes.  When counting is on, every thread increments its
+ * own cache line, so threads that allocate at the same time don't
+ * fight over a shared counter.  The slots are summed when read. */
+static bool enabled = false;
+
+static const size_t slot_count = 64;
+struct alignas(64) slot {
+    std::atomic<size_t> count;
+};
+static slot slots[slot_count];
+static std::atomic<size_t> next_slot(0);
+
+void alloc_count_enable(void)
+{
+    enabled = true;
+}
+
+void *operator new(size_t size)
+{
+    if (enabled == true) {
+        static thread_local size_t mine =
+            next_slot.fetch_add(1, std::memory_order_relaxed) % slot_count;
+        slots[mine].count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+size_t alloc_count(void)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < slot_count; ++i)
+        total += slots[i].count.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALLOC_COUNT_HXX
+#define ALLOC_COUNT_HXX
+
+#include <stddef.h>
+
+/* Starts counting allocations, which is off until this is called. */
+void alloc_count_enable(void);
+
+/* Returns the number of times operator new has been called since
+ * counting was enabled.  This lives in its own file because it
+ * replaces the global allocation functions. */
+size_t alloc_count(void);
+
+#endif
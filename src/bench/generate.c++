@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Generates synthetic Flo designs of a given size, each of which
+ * stresses a different part of the optimizer.  These aren't meant
+ * to compute anything sensible, just to look like the sort of thing
+ * Chisel emits at a scale that makes the passes' running time
+ * matter. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <libflo/sizet_printf.h>
+
+/* Every design has this many inputs, which the logic is built from. */
+static const size_t input_count = 64;
+
+/* Writes out the inputs that every design shares. */
+static void write_inputs(FILE *f, size_t width)
+{
+    for (size_t i = 0; i < input_count; ++i)
+        fprintf(f, "in" SIZET_FORMAT " = in'" SIZET_FORMAT "\n", i, width);
+}
+
+/* Long, left-leaning chains of a single bitwise operation, which is
+ * exactly what the rebalancing pass is meant to fix.  Every chain
+ * picks its inputs with its own LCG, seeded by the chain's number, so
+ * no two chains read the same inputs in the same order. */
+static size_t write_tree(FILE *f, size_t ops, const char *opcode)
+{
+    const size_t depth = 256;
+    size_t written = 0;
+
+    write_inputs(f, 1);
+    for (size_t t = 0; written + depth + 1 <= ops || t == 0; ++t) {
+        uint64_t lcg = t;
+        auto next_input = [&lcg](void) -> size_t
+            {
+                lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+                return (lcg >> 33) % input_count;
+            };
+
+        size_t first = next_input();
+        fprintf(f, "T" SIZET_FORMAT "_0 = %s'1 in" SIZET_FORMAT
+                " in" SIZET_FORMAT "\n",
+                t, opcode, first, next_input());
+
+        for (size_t d = 1; d < depth; ++d) {
+            fprintf(f, "T" SIZET_FORMAT "_" SIZET_FORMAT " = %s'1 T"
+                    SIZET_FORMAT "_" SIZET_FORMAT " in" SIZET_FORMAT "\n",
+                    t, d, opcode, t, d - 1, next_input());
+        }
+
+        fprintf(f, "out" SIZET_FORMAT " = out'1 T" SIZET_FORMAT "_"
+                SIZET_FORMAT "\n",
+                t, t, depth - 1);
+
+        written += depth + 1;
+    }
+
+    return written;
+}
+
+/* Chains of MOVs, which should all be elided. */
+static size_t write_movs(FILE *f, size_t ops)
+{
+    const size_t length = 1024;
+    size_t written = 0;
+
+    write_inputs(f, 32);
+    for (size_t c = 0; written + length + 1 <= ops || c == 0; ++c) {
+        fprintf(f, "M" SIZET_FORMAT "_0 = mov'32 in" SIZET_FORMAT "\n",
+                c, c % input_count);
+
+        for (size_t l = 1; l < length; ++l) {
+            fprintf(f, "M" SIZET_FORMAT "_" SIZET_FORMAT " = mov'32 M"
+                    SIZET_FORMAT "_" SIZET_FORMAT "\n",
+                    c, l, c, l - 1);
+        }
+
+        fprintf(f, "out" SIZET_FORMAT " = out'32 M" SIZET_FORMAT "_"
+                SIZET_FORMAT "\n",
+                c, c, length - 1);
+
+        written += length + 1;
+    }
+
+    return written;
+}
+
+/* A handful of nodes that are each read by a huge number of
+ * operations, which stresses the use lists.  Every result goes
+ * through a register to an output so nothing is dead. */
+static size_t write_fanout(FILE *f, size_t ops)
+{
+    size_t written = 0;
+
+    write_inputs(f, 32);
+    for (size_t i = 0; written + 4 <= ops || i == 0; ++i) {
+        fprintf(f, "F" SIZET_FORMAT " = add'32 in" SIZET_FORMAT " "
+                SIZET_FORMAT "\n",
+                i, i % 4, i);
+        fprintf(f, "X" SIZET_FORMAT " = xor'32 F" SIZET_FORMAT " in"
+                SIZET_FORMAT "\n",
+                i, i, i % 4);
+        fprintf(f, "R" SIZET_FORMAT " = reg'32 1 X" SIZET_FORMAT "\n",
+                i, i);
+        fprintf(f, "out" SIZET_FORMAT " = out'32 R" SIZET_FORMAT "\n",
+                i, i);
+
+        written += 4;
+    }
+
+    return written;
+}
+
+/* Lots of small memories, each with a registered read address and a
+ * write port. */
+static size_t write_memories(FILE *f, size_t ops)
+{
+    size_t written = 0;
+
+    write_inputs(f, 32);
+    for (size_t m = 0; written + 6 <= ops || m == 0; ++m) {
+        fprintf(f, "mem" SIZET_FORMAT " = mem'32 1024\n", m);
+        fprintf(f, "A" SIZET_FORMAT " = rsh'10 in" SIZET_FORMAT " "
+                SIZET_FORMAT "\n",
+                m, m % input_count, m % 22);
+        fprintf(f, "RA" SIZET_FORMAT " = reg'10 1 A" SIZET_FORMAT "\n",
+                m, m);
+        fprintf(f, "D" SIZET_FORMAT " = rd'32 1 mem" SIZET_FORMAT " RA"
+                SIZET_FORMAT "\n",
+                m, m, m);
+        fprintf(f, "N" SIZET_FORMAT " = add'32 D" SIZET_FORMAT " in"
+                SIZET_FORMAT "\n",
+                m, m, (m + 1) % input_count);
+        fprintf(f, "W" SIZET_FORMAT " = wr'32 1 mem" SIZET_FORMAT " RA"
+                SIZET_FORMAT " N" SIZET_FORMAT "\n",
+                m, m, m, m);
+        fprintf(f, "out" SIZET_FORMAT " = out'32 D" SIZET_FORMAT "\n",
+                m, m);
+
+        written += 6;
+    }
+
+    return written;
+}
+
+struct design {
+    const char *name;
+    const char *description;
+    size_t (*write)(FILE *f, size_t ops);
+};
+
+static size_t write_and_tree(FILE *f, size_t ops)
+{
+    return write_tree(f, ops, "and");
+}
+
+static size_t write_or_tree(FILE *f, size_t ops)
+{
+    return write_tree(f, ops, "or");
+}
+
+static const design designs[] = {
+    {"and-tree", "Deep chains of AND operations", &write_and_tree},
+    {"or-tree", "Deep chains of OR operations", &write_or_tree},
+    {"mov-chain", "Long chains of MOVs", &write_movs},
+    {"fanout", "A few nodes read by many operations", &write_fanout},
+    {"memories", "Many small memories", &write_memories},
+};
+
+int main(int argc, const char **argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "--list") == 0)) {
+        for (const auto& d: designs)
+            printf("%s\n", d.name);
+        return 0;
+    }
+
+    if ((argc != 3) && (argc != 4)) {
+        printf("flo-opt-bench-gen <design> <ops> [out.flo]: "
+               "Generates a synthetic Flo design\n");
+        printf("  --list: Lists the available designs\n");
+        for (const auto& d: designs)
+            printf("  %s: %s\n", d.name, d.description);
+        return (argc == 1) ? 0 : 1;
+    }
+
+    const design *found = NULL;
+    for (const auto& d: designs)
+        if (strcmp(d.name, argv[1]) == 0)
+            found = &d;
+
+    if (found == NULL) {
+        fprintf(stderr, "Unknown design '%s'\n", argv[1]);
+        return 1;
+    }
+
+    size_t ops = strtoul(argv[2], NULL, 0);
+
+    /* Designs can be tens of millions of lines, so they're written
+     * through a large buffer. */
+    bool out_is_stdout = (argc == 3) || (strcmp(argv[3], "-") == 0);
+    auto out_file = out_is_stdout ? stdout : fopen(argv[3], "w");
+    if (out_file == NULL) {
+        perror(argv[3]);
+        return 1;
+    }
+
+    static char buffer[1 << 20];
+    setvbuf(out_file, buffer, _IOFBF, sizeof(buffer));
+
+    size_t written = found->write(out_file, ops);
+    fprintf(stderr, "Generated " SIZET_FORMAT " operations\n", written);
+
+    if (out_is_stdout)
+        fflush(out_file);
+    else
+        fclose(out_file);
+
+    return 0;
+}
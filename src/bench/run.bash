@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# Runs flo-opt over a set of synthetic designs of increasing size,
+# writing one JSON object per run to standard output.  Each object
+# contains flo-opt's own per-pass statistics (time, ops/second, and
+# memory), so results from two versions can be diffed directly.
+#
+# Usage: flo-opt-bench [-j <N>] [<ops> ...]
+
+set -e
+set -o pipefail
+
+# The other tools are expected to be installed next to this one, but
+# fall back to whatever's in the PATH.
+bindir="$(dirname "$0")"
+flo_opt="$bindir/flo-opt"
+bench_gen="$bindir/flo-opt-bench-gen"
+if [[ ! -x "$flo_opt" ]]
+then
+    flo_opt="flo-opt"
+fi
+if [[ ! -x "$bench_gen" ]]
+then
+    bench_gen="flo-opt-bench-gen"
+fi
+
+threads="1"
+sizes=()
+while [[ "$1" != "" ]]
+do
+    case "$1" in
+    -j)
+        threads="$2"
+        shift 2
+        ;;
+    --help)
+        echo "flo-opt-bench [-j <N>] [<ops> ...]: Benchmarks flo-opt's passes"
+        echo "  Sizes default to 10^4, 10^5 and 10^6 operations"
+        exit 0
+        ;;
+    *)
+        sizes+=("$1")
+        shift
+        ;;
+    esac
+done
+
+if [[ "${#sizes[@]}" == 0 ]]
+then
+    sizes=(10000 100000 1000000)
+fi
+
+tempdir="$(mktemp -d -t flo-opt-bench.XXXXXXXXXX)"
+trap "rm -rf $tempdir" EXIT
+
+"$bench_gen" --list | while read design
+do
+    for size in "${sizes[@]}"
+    do
+        "$bench_gen" $design $size "$tempdir"/in.flo 2>/dev/null
+
+        start="$(date +%s.%N)"
+        "$flo_opt" -j $threads --stats="$tempdir"/stats.json \
+            "$tempdir"/in.flo "$tempdir"/out.flo
+        end="$(date +%s.%N)"
+
+        echo -n "{ \"design\": \"$design\", \"ops\": $size, "
+        echo -n "\"threads\": $threads, "
+        echo -n "\"wall_seconds\": $(awk "BEGIN { printf \"%.6f\", $end - $start }"), "
+        echo -n "\"stats\": "
+        tr -d '\n' < "$tempdir"/stats.json | tr -s ' '
+        echo " }"
+    done
+done
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "flo_writer.h++"
+#include <ctype.h>
+#include <string.h>
+
+flo_writer::flo_writer(FILE *file, size_t buffer_size)
+    : _file(file),
+      _buffer(buffer_size),
+      _used(0),
+      _failed(false),
+      _opcode_names()
+{
+}
+
+flo_writer::~flo_writer(void)
+{
+    flush();
+}
+
+void flo_writer::write_mem(const std::shared_ptr<node>& mem)
+{
+    append(mem->name());
+    append(" = mem'", strlen(" = mem'"));
+    append_number(mem->width());
+    append(' ');
+    append_number(mem->depth());
+    append('\n');
+}
+
+void flo_writer::write_op(const std::shared_ptr<operation>& op)
+{
+    append(op->d()->name());
+    append(" = ", strlen(" = "));
+    append(opcode_name(op->op()));
+    append('\'');
+    append_number(op->width());
+
+    for (const auto& source: op->sources()) {
+        append(' ');
+        append(source->name());
+    }
+
+    append('\n');
+}
+
+bool flo_writer::flush(void)
+{
+    if (_used > 0 && fwrite(_buffer.data(), 1, _used, _file) != _used)
+        _failed = true;
+    _used = 0;
+
+    return _failed == false;
+}
+
+void flo_writer::append(const char *data, size_t length)
+{
+    if (_used + length > _buffer.size()) {
+        flush();
+
+        /* Anything that won't fit even in an empty buffer just goes
+         * straight out. */
+        if (length > _buffer.size()) {
+            if (fwrite(data, 1, length, _file) != length)
+                _failed = true;
+            return;
+        }
+    }
+
+    memcpy(_buffer.data() + _used, data, length);
+    _used += length;
+}
+
+void flo_writer::append(char c)
+{
+    if (_used == _buffer.size())
+        flush();
+
+    _buffer[_used++] = c;
+}
+
+void flo_writer::append_number(size_t n)
+{
+    char digits[32];
+    size_t length = 0;
+    do {
+        digits[length++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+
+    while (length > 0)
+        append(digits[--length]);
+}
+
+const std::string& flo_writer::opcode_name(const libflo::opcode& op)
+{
+    size_t index = (size_t)op;
+    if (index >= _opcode_names.size())
+        _opcode_names.resize(index + 1);
+
+    /* Flo files always use lower-case opcodes. */
+    auto& name = _opcode_names[index];
+    if (name.size() == 0) {
+        name = libflo::opcode_to_string(op);
+        for (auto& c: name)
+            c = tolower(c);
+    }
+
+    return name;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLO_WRITER_HXX
+#define FLO_WRITER_HXX
+
+#include <libflo/opcode.h++>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "operation.h++"
+#include "node.h++"
+
+/* Writes a Flo file out through a large, reusable buffer.  Every
+ * line is formatted directly into that buffer, which avoids both the
+ * temporary strings that "operation::to_string()" builds and the
+ * per-line overhead of stdio. */
+class flo_writer {
+private:
+    FILE *_file;
+    std::vector<char> _buffer;
+    size_t _used;
+
+    /* Set once any write to the file comes up short. */
+    bool _failed;
+
+    /* The textual name of every opcode, looked up once. */
+    std::vector<std::string> _opcode_names;
+
+public:
+    flo_writer(FILE *file, size_t buffer_size = 1 << 20);
+    ~flo_writer(void);
+
+public:
+    /* Writes out the declaration of a memory node. */
+    void write_mem(const std::shared_ptr<node>& mem);
+
+    /* Writes out a single operation, on its own line. */
+    void write_op(const std::shared_ptr<operation>& op);
+
+    /* Pushes everything that's been buffered out to the file,
+     * returning FALSE if anything written so far has failed. */
+    bool flush(void);
+
+    /* Returns TRUE if any write to the file has failed. */
+    bool failed(void) const { return _failed; }
+
+private:
+    void append(const char *data, size_t length);
+    void append(const std::string& s) { append(s.data(), s.size()); }
+    void append(char c);
+    void append_number(size_t n);
+    const std::string& opcode_name(const libflo::opcode& op);
+};
+
+#endif
@@ -20,170 +20,249 @@
  */
 
 #include "connected_components.h++"
-#include <unordered_map>
-#include <queue>
+#include "dense_graph.h++"
+#include "thread_pool.h++"
+#include "union_find.h++"
 using namespace libpass;
 
-namespace std {
-    template <class item_t>
-    std::queue<item_t> make_queue(const item_t& item)
-    { return std::queue<item_t>({item}); }
+/* Shards smaller than this aren't worth handing to another thread. */
+static const size_t min_ops_per_thread = 1 << 16;
 
-    template <class item_t>
-    std::vector<item_t> make_vector(const item_t& item)
-    { return std::vector<item_t>({item}); }
+static bool check_all = false;
+
+/* Adapts a test function that works on a flo's shared_ptrs so it can
+ * be used on a dense_graph. */
+static connected_components::edge_func_t
+ptr_edge_func(const dense_graph& dense,
+              const connected_components::test_func_t& func)
+{
+    return [&dense, func](dense_graph::op_id link,
+                          dense_graph::node_id from,
+                          dense_graph::node_id to)
+        -> bool
+        {
+            return func(dense.op_at(link),
+                        dense.node_at(from),
+                        dense.node_at(to));
+        };
+}
+
+void libpass::set_check_components(bool check)
+{
+    check_all = check;
+}
+
+bool libpass::check_components(void)
+{
+    return check_all;
 }
 
 connected_components::connected_components(const flo_ptr& graph,
-                                           test_func_t func)
+                                           test_func_t func,
+                                           size_t threads,
+                                           bool check)
     : _comp2node(),
       _comp2op(),
-      _comps()
+      _comps(),
+      _comp_offset(),
+      _comp_ops()
 {
-    /* The first thing we need to do here is beild the incoming and
-     * outgoing maps.  These allow me to quickly build the connected
-     * component of a graph without the need to call the node
-     * interrogation function a large number of times. */
-    std::multimap<node_ptr, node_ptr> incoming, outgoing;
-    for (const auto& edge: graph->operations()) {
-        auto to = edge->d();
-        for (const auto& from: edge->sources()) {
-            if (func(edge, from, to) == true) {
-                incoming.insert(std::make_pair(to, from));
-                outgoing.insert(std::make_pair(from, to));
-            }
-        }
-    }
+    /* Everything here works on node indices rather than on the
+     * nodes themselves, which avoids hashing a shared_ptr every time
+     * an edge is looked at. */
+    dense_graph dense(graph);
+    build(dense, ptr_edge_func(dense, func), threads, check, true);
+}
 
-    /* Create a map from nodes to operations -- this way we only need
-     * to track the nodes of a connected component (which makes the
-     * whole thing look more like a regular graph algorithm) but we
-     * can still return the operation list. */
-    std::unordered_map<node_ptr, operation_ptr> node2op;
-    for (const auto& op: graph->operations())
-        node2op[op->d()] = op;
-
-    /* Begin building the connected component map by simply picking
-     * some node that's yet to be assigned to a component, assigning
-     * it to a component, and then proceeding to walk every node
-     * that's connected to that node in order to produce the connected
-     * component. */
-    std::unordered_map<node_ptr, size_t> node2comp;
-    std::multimap<size_t, node_ptr> comp2node;
-    size_t current_component = 0;
-    for (const auto& node: graph->nodes()) {
-        bool inc_component = false;
-
-        /* If this node was previously found then don't worry about it
-         * at all! */
-        if (node2comp.find(node) != node2comp.end())
-            continue;
+connected_components::connected_components(const dense_graph& graph,
+                                           test_func_t func,
+                                           size_t threads,
+                                           bool check)
+    : _comp2node(),
+      _comp2op(),
+      _comps(),
+      _comp_offset(),
+      _comp_ops()
+{
+    build(graph, ptr_edge_func(graph, func), threads, check, true);
+}
 
-        /* There's just a queue here which ensures that every node is
-         * eventually found.  The invariant is that any node that's
-         * been inserted into "node2comp" has been inserted into this
-         * queue exactly once (though it may have been on another run
-         * through the top-level loop).  The one exception is that
-         * first node that was added, which isn't added anywhere. */
-        auto to_process = std::make_queue(node);
-        while (to_process.size() > 0) {
-            auto cur = to_process.front();
-            to_process.pop();
-
-            /* Check to see if this node has already been placed into
-             * a component.  If so then we don't need to enqueue it
-             * again, as it's already been processed. */
-            auto l = node2comp.find(cur);
-
-            if (l != node2comp.end()) {
-                /* Here's a consistancy check: if we can reach a node
-                 * in a different connected component from this
-                 * connected component then that's a problem. */
-                if (l->second != current_component) {
-                    fprintf(stderr, "ERROR: node '%s' connects to '%s'\n",
-                            node->name().c_str(),
-                            cur->name().c_str()
-                        );
-                    fprintf(stderr, "  '%s' in " SIZET_FORMAT "\n",
-                            cur->name().c_str(),
-                            l->second
-                        );
-                    fprintf(stderr, "  '%s' in " SIZET_FORMAT "\n",
-                            node->name().c_str(),
-                            current_component
-                        );
-                    abort();
-                }
+connected_components::connected_components(const dense_graph& graph,
+                                           dense_test_func_t func,
+                                           size_t threads,
+                                           bool check)
+    : _comp2node(),
+      _comp2op(),
+      _comps(),
+      _comp_offset(),
+      _comp_ops()
+{
+    auto edge = [func](op_id link,
+                       node_id from __attribute__((unused)),
+                       node_id to __attribute__((unused)))
+        -> bool
+        {
+            return func(link);
+        };
+    build(graph, edge, threads, check, false);
+}
 
-                /* Move on to another node, this one has already been
-                 * placed. */
-                continue;
+void connected_components::build(const dense_graph& dense,
+                                 edge_func_t func,
+                                 size_t threads,
+                                 bool check,
+                                 bool with_ptrs)
+{
+    size_t node_count = dense.node_count();
+    size_t op_count = dense.op_count();
+
+    /* Calls "visit" on every edge (as defined by the test function)
+     * within the given range of operations. */
+    auto for_each_edge = [&](op_id begin, op_id end,
+                             std::function<void(node_id, node_id)> visit)
+        -> void
+        {
+            for (op_id o = begin; o < end; ++o) {
+                if (dense.is_live(o) == false)
+                    continue;
+
+                auto to = dense.dest(o);
+                for (auto it = dense.sources_begin(o);
+                     it != dense.sources_end(o);
+                     ++it) {
+                    if (func(o, *it, to) == true)
+                        visit(*it, to);
+                }
             }
+        };
+
+    if (check_all == true)
+        check = true;
+
+    /* Merge the two ends of every edge together, which leaves every
+     * connected component as one set.  Large graphs get split into
+     * shards of operations that are merged concurrently on the shared
+     * thread pool. */
+    std::vector<uint32_t> root(node_count);
+    if (threads > op_count / min_ops_per_thread)
+        threads = op_count / min_ops_per_thread;
+
+    if (threads > 1) {
+        concurrent_union_find uf(node_count);
+
+        default_thread_pool().parallel_for(
+            threads,
+            [&](size_t t) -> void
+            {
+                op_id begin = (op_count * t) / threads;
+                op_id end = (op_count * (t + 1)) / threads;
+                for_each_edge(begin, end,
+                              [&](node_id a, node_id b) -> void
+                              { uf.unite(a, b); }
+                    );
+            });
+
+        for (node_id n = 0; n < node_count; ++n)
+            root[n] = uf.find(n);
+    } else {
+        union_find uf(node_count);
+
+        for_each_edge(0, op_count,
+                      [&](node_id a, node_id b) -> void
+                      { uf.unite(a, b); }
+            );
+
+        for (node_id n = 0; n < node_count; ++n)
+            root[n] = uf.find(n);
+    }
 
-            /* At this point we know that this node has yet to
-             * actually be placed in any component.  That means we
-             * want to insert this node and all the nodes it can see
-             * into this node's connected component.  As there's a
-             * whole bunch of stuff that needs to do exactly the same
-             * operation, this function quickly allows us to do
-             * that. */
-            auto insert_node = [&](const node_ptr& node) -> void
-                {
-                    if (node2comp.find(node) != node2comp.end())
-                        return;
-
-                    node2comp[node] = current_component;
-                    comp2node.insert(std::make_pair(current_component, node));
-                    to_process.push(node);
-                    inc_component = true;
-                };
-
-            /* Now we simply insert every node this one can see. */
-            insert_node(cur);
-            for (auto it = incoming.find(cur); it != incoming.end(); ++it)
-                insert_node(it->second);
-            for (auto it = outgoing.find(cur); it != outgoing.end(); ++it)
-                insert_node(it->second);
+    /* Number the components in the order their first node shows up,
+     * which keeps the output deterministic regardless of how the sets
+     * happened to be merged. */
+    std::vector<uint32_t> root2comp(node_count, dense_graph::none);
+    std::vector<uint32_t> node2comp(node_count);
+    for (node_id n = 0; n < node_count; ++n) {
+        auto& comp = root2comp[root[n]];
+        if (comp == dense_graph::none) {
+            comp = _comps.size();
+            _comps.push_back(comp);
+            if (with_ptrs == true) {
+                _comp2node.push_back(std::vector<node_ptr>());
+                _comp2op.push_back(std::vector<operation_ptr>());
+            }
         }
 
-        if (inc_component == true)
-            current_component++;
+        node2comp[n] = comp;
     }
 
-    /* At this point we're done, which means it's time to sanity check
-     * the list of components that were discovered while adding them
-     * all to the big map. */
-    for (size_t cmp = 0; cmp < current_component; ++cmp) {
-        std::vector<node_ptr> nodes;
-        std::vector<operation_ptr> ops;
+    /* And here's really the crux of the whole thing: we're just
+     * building up the internal data structures that represent all the
+     * connected components of a graph.  Each node's operation lands
+     * in the same component as that node.  Operations are counted
+     * first so they can all be stored in a single array. */
+    _comp_offset.assign(_comps.size() + 1, 0);
+    for (node_id n = 0; n < node_count; ++n)
+        if (dense.def(n) != dense_graph::none)
+            _comp_offset[node2comp[n] + 1]++;
+    for (size_t i = 1; i < _comp_offset.size(); ++i)
+        _comp_offset[i] += _comp_offset[i - 1];
 
-        for (auto it = comp2node.find(cmp); it != comp2node.upper_bound(cmp) && it != comp2node.end(); ++it) {
-            auto node = it->second;
+    _comp_ops.resize(_comp_offset.back());
+    std::vector<uint32_t> fill(_comp_offset.begin(), _comp_offset.end() - 1);
+    for (node_id n = 0; n < node_count; ++n) {
+        auto comp = node2comp[n];
+        if (with_ptrs == true)
+            _comp2node[comp].push_back(dense.node_at(n));
 
-            auto l = node2comp.find(node);
-            if (l == node2comp.end()) {
-                fprintf(stderr, "Found one-directional component\n");
-                abort();
-            }
+        auto def = dense.def(n);
+        if (def == dense_graph::none)
+            continue;
 
-            if (l->second != cmp) {
-                fprintf(stderr, "Found mis-matched component\n");
-                abort();
-            }
+        _comp_ops[fill[comp]++] = def;
+        if (with_ptrs == true)
+            _comp2op[comp].push_back(dense.op_at(def));
+    }
 
-            nodes.push_back(node);
+    /* This is a consistancy check: every edge must stay within a
+     * single component and every live operation must have been
+     * placed exactly once, otherwise something has gone very wrong above. */
+    if (check == true) {
+        auto name = [&](node_id n) -> const char *
+            {
+                return (dense.name(n) == NULL) ? "<temporary>" : dense.name(n);
+            };
 
-            auto ol = node2op.find(node);
-            if (ol != node2op.end())
-                ops.push_back(ol->second);
-        }
+        for_each_edge(0, op_count,
+                      [&](node_id from, node_id to) -> void
+                      {
+                          if (node2comp[from] == node2comp[to])
+                              return;
+
+                          fprintf(stderr, "ERROR: node '%s' connects to '%s'\n",
+                                  name(from),
+                                  name(to)
+                              );
+                          fprintf(stderr, "  '%s' in " SIZET_FORMAT "\n",
+                                  name(from),
+                                  (size_t)node2comp[from]
+                              );
+                          fprintf(stderr, "  '%s' in " SIZET_FORMAT "\n",
+                                  name(to),
+                                  (size_t)node2comp[to]
+                              );
+                          abort();
+                      }
+            );
 
-        /* And here's really the crux of the whole thing: we're just
-         * building up the internal data structures that represent all
-         * the connected components of a graph.  Unfortunately C++
-         * doesn't allow us to mark these as const... :(. */
-        _comp2node[cmp] = nodes;
-        _comp2op[cmp] = ops;
-        _comps.push_back(cmp);
+        std::vector<uint32_t> listed(op_count, 0);
+        for (const auto& o: _comp_ops)
+            listed[o]++;
+        for (op_id o = 0; o < op_count; ++o) {
+            if (listed[o] == (dense.is_live(o) ? 1 : 0))
+                continue;
+
+            fprintf(stderr, "Found mis-matched component\n");
+            abort();
+        }
     }
 }
@@ -23,8 +23,9 @@
 #define LIBPASS__CONNECTED_COMPONENTS_HXX
 
 #include <flo.h++>
+#include "dense_graph.h++"
 #include <functional>
-#include <unordered_map>
+#include <vector>
 
 namespace libpass {
     /* Finds a set of connected components inside a Flo file. */
@@ -33,11 +34,38 @@ namespace libpass {
         typedef std::shared_ptr<operation> operation_ptr;
         typedef std::shared_ptr<flo> flo_ptr;
 
+    public:
+        typedef dense_graph::node_id node_id;
+        typedef dense_graph::op_id op_id;
+
     private:
-        std::unordered_map<size_t, std::vector<node_ptr>> _comp2node;
-        std::unordered_map<size_t, std::vector<operation_ptr>> _comp2op;
+        std::vector<std::vector<node_ptr>> _comp2node;
+        std::vector<std::vector<operation_ptr>> _comp2op;
         std::vector<size_t> _comps;
 
+        /* The operations of component "i" are stored in
+         * "_comp_ops[_comp_offset[i]]" up to (but not including)
+         * "_comp_ops[_comp_offset[i+1]]", so most components (which
+         * are single nodes) don't need an allocation of their own. */
+        std::vector<uint32_t> _comp_offset;
+        std::vector<op_id> _comp_ops;
+
+    public:
+        /* The operations of a single component. */
+        class op_range {
+        private:
+            const op_id *_begin;
+            const op_id *_end;
+
+        public:
+            op_range(const op_id *begin, const op_id *end)
+                : _begin(begin), _end(end) {}
+
+            const op_id *begin(void) const { return _begin; }
+            const op_id *end(void) const { return _end; }
+            size_t size(void) const { return _end - _begin; }
+        };
+
     public:
         /* This is a test function, which returns TRUE if the
          * operation "link" provides a connected edge from the vertex
@@ -46,11 +74,48 @@ namespace libpass {
                                                const node_ptr& from,
                                                const node_ptr& to)>;
 
+        /* The same sort of test function, but for a dense_graph: it
+         * returns TRUE if every operand of "link" is connected to
+         * its destination. */
+        using dense_test_func_t = std::function<bool(op_id link)>;
+
+        /* Used internally to test a single edge of a dense_graph. */
+        using edge_func_t = std::function<bool(op_id link,
+                                               node_id from,
+                                               node_id to)>;
+
     public:
         /* Finds all the connected components of the given graph,
          * where connectivity is defined by the given function as
-         * described above. */
-        connected_components(const flo_ptr& graph, test_func_t func);
+         * described above.  When "threads" is larger than one the
+         * edges are split into that many shards and merged
+         * concurrently, in which case "func" must be safe to call
+         * from multiple threads.  Setting "check" (or turning on
+         * set_check_components() below) re-verifies the result and
+         * aborts if any edge crosses a component boundary, which is
+         * slow but useful for debugging. */
+        connected_components(const flo_ptr& graph,
+                             test_func_t func,
+                             size_t threads = 1,
+                             bool check = false);
+
+        /* The same as above, but for a graph that's already been
+         * converted to a dense_graph. */
+        connected_components(const dense_graph& graph,
+                             test_func_t func,
+                             size_t threads = 1,
+                             bool check = false);
+
+        /* Finds the connected components of a dense_graph using a
+         * test function that only looks at IDs.  Components built
+         * this way only list their operations by ID, which means no
+         * shared_ptr ever gets touched -- and so this works on a
+         * graph that's been modified in place, whose new operations
+         * don't have a flo operation yet. */
+        connected_components(const dense_graph& graph,
+                             dense_test_func_t func,
+                             size_t threads = 1,
+                             bool check = false);
 
     public:
         /* Lists the component IDs that were inferred. */
@@ -59,11 +124,31 @@ namespace libpass {
 
         /* Lists the components that match a particular ID, either by
          * node name or by operation name. */
-        const std::vector<node_ptr>& nodes(size_t id)
+        const std::vector<node_ptr>& nodes(size_t id) const
             { return _comp2node[id]; }
-        const std::vector<operation_ptr>& ops(size_t id)
+        const std::vector<operation_ptr>& ops(size_t id) const
             { return _comp2op[id]; }
+
+        /* Lists the operations of a component by ID. */
+        op_range op_ids(size_t id) const
+            {
+                return op_range(_comp_ops.data() + _comp_offset[id],
+                                _comp_ops.data() + _comp_offset[id + 1]);
+            }
+
+    private:
+        void build(const dense_graph& dense,
+                   edge_func_t func,
+                   size_t threads,
+                   bool check,
+                   bool with_ptrs);
     };
+
+    /* Turns on the consistency check for every set of connected
+     * components that gets built, no matter what its caller asked
+     * for. */
+    void set_check_components(bool check);
+    bool check_components(void);
 }
 
 #endif
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "dense_graph.h++"
+using namespace libpass;
+
+const uint32_t dense_graph::none;
+
+dense_graph::dense_graph(const flo_ptr& graph)
+    : _node_ptr(),
+      _node_width(),
+      _node_flags(),
+      _node_def(),
+      _op_code(),
+      _op_dest(),
+      _op_src_offset(),
+      _op_src(),
+      _op_ptr(),
+      _op_live(),
+      _live_op_count(0),
+      _slot_op(),
+      _use_next(),
+      _use_prev(),
+      _node_first_use(),
+      _node_use_count(),
+      _version(0),
+      _order(),
+      _order_end(0),
+      _touched(),
+      _log_touched(false),
+      _ptr2id(),
+      _const2id()
+{
+    /* Nodes are numbered in the order they're first seen in the
+     * operation list, which tends to keep nodes that are used
+     * together close together.  Nodes that aren't touched by any
+     * operation (memories, for example) are numbered afterwards. */
+    const auto& ops = graph->operations();
+    _op_code.reserve(ops.size());
+    _op_dest.reserve(ops.size());
+    _op_ptr.reserve(ops.size());
+    _op_live.reserve(ops.size());
+    _op_src_offset.reserve(ops.size() + 1);
+    _ptr2id.reserve(ops.size() * 2);
+
+    _op_src_offset.push_back(0);
+    for (const auto& op: ops) {
+        std::vector<node_id> sources;
+        sources.reserve(op->sources().size());
+        for (const auto& source: op->sources())
+            sources.push_back(add_node(source));
+
+        auto o = add_op(add_node(op->d()), op->op(), sources);
+        _op_ptr[o] = op;
+    }
+
+    for (const auto& node: graph->nodes())
+        add_node(node);
+
+    _version = 0;
+    _log_touched = true;
+}
+
+dense_graph::node_id dense_graph::lookup(const node_ptr& n) const
+{
+    auto l = _ptr2id.find(n.get());
+    if (l == _ptr2id.end())
+        return none;
+    return l->second;
+}
+
+dense_graph::node_id dense_graph::add_temp(node_id t)
+{
+    node_id id = _node_width.size();
+
+    _node_ptr.push_back(node_ptr());
+    _node_width.push_back(_node_width[t]);
+    _node_flags.push_back(_node_flags[t] & FLAG_KNOWN_WIDTH);
+    _node_def.push_back(none);
+    _node_first_use.push_back(none);
+    _node_use_count.push_back(0);
+
+    return id;
+}
+
+dense_graph::node_id dense_graph::add_const(const std::string& value,
+                                           size_t width)
+{
+    auto l = _const2id.find(value + "'" + std::to_string(width));
+    if (l != _const2id.end())
+        return l->second;
+
+    auto n = std::make_shared<node>(value,
+                                    libflo::unknown<size_t>(width),
+                                    libflo::unknown<size_t>(),
+                                    false,
+                                    true,
+                                    libflo::unknown<size_t>(),
+                                    libflo::unknown<std::string>()
+        );
+    return add_node(n);
+}
+
+dense_graph::op_id dense_graph::add_op(node_id dest,
+                                       libflo::opcode opcode,
+                                       const std::vector<node_id>& sources)
+{
+    op_id id = _op_code.size();
+
+    _op_code.push_back(opcode);
+    _op_dest.push_back(dest);
+    _op_ptr.push_back(operation_ptr());
+    _op_live.push_back(true);
+    _live_op_count++;
+
+    for (const auto& source: sources) {
+        uint32_t slot = _op_src.size();
+        _op_src.push_back(source);
+        _slot_op.push_back(id);
+        _use_next.push_back(none);
+        _use_prev.push_back(none);
+        link_use(slot);
+    }
+    _op_src_offset.push_back(_op_src.size());
+
+    /* When there's more than one operation that writes to a node the
+     * last one wins, which matches what building a map from the flo
+     * would do. */
+    _node_def[dest] = id;
+
+    touch(id);
+    for (const auto& source: sources)
+        touch_def(source);
+    touch_uses(dest);
+
+    _version++;
+    return id;
+}
+
+void dense_graph::erase_op(op_id o)
+{
+    if (_op_live[o] == false)
+        return;
+
+    for (uint32_t slot = _op_src_offset[o]; slot < _op_src_offset[o+1]; ++slot)
+        unlink_use(slot);
+
+    touch(o);
+    for (uint32_t slot = _op_src_offset[o]; slot < _op_src_offset[o+1]; ++slot)
+        touch_def(_op_src[slot]);
+    touch_uses(_op_dest[o]);
+
+    if (_node_def[_op_dest[o]] == o)
+        _node_def[_op_dest[o]] = none;
+
+    _op_live[o] = false;
+    _op_ptr[o] = operation_ptr();
+    _live_op_count--;
+    _version++;
+}
+
+void dense_graph::set_source(op_id o, size_t i, node_id n)
+{
+    uint32_t slot = _op_src_offset[o] + i;
+    if (_op_src[slot] == n)
+        return;
+
+    touch(o);
+    touch_def(_op_src[slot]);
+    touch_def(n);
+
+    unlink_use(slot);
+    _op_src[slot] = n;
+    link_use(slot);
+
+    _op_ptr[o] = operation_ptr();
+    _version++;
+}
+
+size_t dense_graph::replace_all_uses(node_id from, node_id to)
+{
+    if (from == to)
+        return 0;
+
+    size_t count = 0;
+    while (_node_first_use[from] != none) {
+        uint32_t slot = _node_first_use[from];
+        touch(_slot_op[slot]);
+
+        unlink_use(slot);
+        _op_src[slot] = to;
+        link_use(slot);
+
+        _op_ptr[_slot_op[slot]] = operation_ptr();
+        count++;
+    }
+
+    if (count > 0) {
+        touch_def(from);
+        touch_def(to);
+        _version++;
+    }
+    return count;
+}
+
+void dense_graph::set_order(const std::vector<op_id>& order)
+{
+    _order = order;
+    _order_end = op_count();
+    _version++;
+}
+
+std::vector<dense_graph::op_id> dense_graph::emission_order(void) const
+{
+    std::vector<op_id> ops;
+    ops.reserve(_live_op_count);
+
+    for (const auto& o: _order)
+        if (_op_live[o] == true)
+            ops.push_back(o);
+
+    for (op_id o = _order_end; o < op_count(); ++o)
+        if (_op_live[o] == true)
+            ops.push_back(o);
+
+    return ops;
+}
+
+dense_graph::flo_ptr dense_graph::to_flo(void)
+{
+    return to_flo(emission_order());
+}
+
+dense_graph::flo_ptr dense_graph::to_flo(const std::vector<op_id>& ops)
+{
+    auto out = flo::empty();
+
+    for (const auto& o: ops) {
+        if (_op_ptr[o] == NULL) {
+            std::vector<node_ptr> sv;
+            sv.reserve(source_count(o));
+            for (auto it = sources_begin(o); it != sources_end(o); ++it)
+                sv.push_back(materialize(*it));
+
+            const auto& d = materialize(_op_dest[o]);
+            _op_ptr[o] = std::make_shared<operation>(
+                d,
+                d->width_u(),
+                _op_code[o],
+                sv
+                );
+        }
+
+        out->add_op(_op_ptr[o]);
+    }
+
+    return out;
+}
+
+void dense_graph::touch(op_id o)
+{
+    if (_log_touched == true && o != none)
+        _touched.push_back(o);
+}
+
+void dense_graph::touch_uses(node_id n)
+{
+    if (_log_touched == false)
+        return;
+
+    for (const auto& user: uses(n))
+        touch(user);
+}
+
+dense_graph::node_id dense_graph::add_node(const node_ptr& n)
+{
+    auto l = _ptr2id.find(n.get());
+    if (l != _ptr2id.end())
+        return l->second;
+
+    /* Constants are only shared when their width is known, as
+     * otherwise different uses could end up with different widths. */
+    std::string const_key;
+    if (n->is_const() && n->known_width()) {
+        const_key = n->name() + "'" + std::to_string(n->width());
+
+        auto c = _const2id.find(const_key);
+        if (c != _const2id.end()) {
+            _ptr2id[n.get()] = c->second;
+            return c->second;
+        }
+    }
+
+    node_id id = _node_width.size();
+    _ptr2id[n.get()] = id;
+    if (const_key.size() > 0)
+        _const2id[const_key] = id;
+
+    uint8_t flags = 0;
+    if (n->is_mem())
+        flags |= FLAG_MEM;
+    if (n->is_const())
+        flags |= FLAG_CONST;
+    if (n->known_width())
+        flags |= FLAG_KNOWN_WIDTH;
+
+    _node_ptr.push_back(n);
+    _node_width.push_back(n->known_width() ? n->width() : 0);
+    _node_flags.push_back(flags);
+    _node_def.push_back(none);
+    _node_first_use.push_back(none);
+    _node_use_count.push_back(0);
+
+    return id;
+}
+
+const dense_graph::node_ptr& dense_graph::materialize(node_id n)
+{
+    if (_node_ptr[n] != NULL)
+        return _node_ptr[n];
+
+    auto width = known_width(n)
+        ? libflo::unknown<size_t>(_node_width[n])
+        : libflo::unknown<size_t>();
+    _node_ptr[n] = node::make_temp(width);
+    _ptr2id[_node_ptr[n].get()] = n;
+
+    return _node_ptr[n];
+}
+
+void dense_graph::link_use(uint32_t slot)
+{
+    node_id n = _op_src[slot];
+    uint32_t head = _node_first_use[n];
+
+    _use_prev[slot] = none;
+    _use_next[slot] = head;
+    if (head != none)
+        _use_prev[head] = slot;
+    _node_first_use[n] = slot;
+    _node_use_count[n]++;
+}
+
+void dense_graph::unlink_use(uint32_t slot)
+{
+    node_id n = _op_src[slot];
+    uint32_t prev = _use_prev[slot];
+    uint32_t next = _use_next[slot];
+
+    if (prev == none)
+        _node_first_use[n] = next;
+    else
+        _use_next[prev] = next;
+    if (next != none)
+        _use_prev[next] = prev;
+
+    _use_prev[slot] = none;
+    _use_next[slot] = none;
+    _node_use_count[n]--;
+}
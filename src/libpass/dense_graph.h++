@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPASS__DENSE_GRAPH_HXX
+#define LIBPASS__DENSE_GRAPH_HXX
+
+#include <flo.h++>
+#include <libflo/opcode.h++>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace libpass {
+    /* A compact, index-based copy of a Flo graph.  Every node and
+     * every operation is given a small integer ID, and all the
+     * per-node and per-operation data lives in flat arrays indexed by
+     * that ID.  Operands are stored contiguously, and both the
+     * definitions and the uses of every node are available without
+     * any hashing, which means passes can walk the graph without
+     * building their own maps from the shared_ptr-based flo.  The
+     * graph is built once from a flo, can be rewritten in place (with
+     * definitions and uses kept up to date), and can be converted
+     * back into a flo for output. */
+    class dense_graph {
+        typedef std::shared_ptr<node> node_ptr;
+        typedef std::shared_ptr<operation> operation_ptr;
+        typedef std::shared_ptr<flo> flo_ptr;
+
+    public:
+        typedef uint32_t node_id;
+        typedef uint32_t op_id;
+
+        /* Returned whenever there's no node or operation to speak
+         * of, for example as the definition of a node that's never
+         * written. */
+        static const uint32_t none = UINT32_MAX;
+
+        /* Walks the operations that read a node.  An operation that
+         * reads the same node more than once shows up once for every
+         * time it reads it. */
+        class use_iterator {
+        private:
+            const dense_graph *_graph;
+            uint32_t _slot;
+
+        public:
+            use_iterator(const dense_graph *graph, uint32_t slot)
+                : _graph(graph), _slot(slot) {}
+
+            op_id operator*(void) const
+                { return _graph->_slot_op[_slot]; }
+            use_iterator& operator++(void)
+                { _slot = _graph->_use_next[_slot]; return *this; }
+            bool operator!=(const use_iterator& o) const
+                { return _slot != o._slot; }
+        };
+
+        class use_range {
+        private:
+            use_iterator _begin;
+
+        public:
+            use_range(const use_iterator& begin): _begin(begin) {}
+            use_iterator begin(void) const { return _begin; }
+            use_iterator end(void) const { return use_iterator(NULL, none); }
+        };
+
+    private:
+        /* Per-node data.  Names aren't copied out of the flo's
+         * nodes, they're read straight from "_node_ptr".  Temporary
+         * nodes that were created by a pass don't have a flo node
+         * (and so don't have a name) until they're converted back
+         * into a flo. */
+        std::vector<node_ptr> _node_ptr;
+        std::vector<size_t> _node_width;
+        std::vector<uint8_t> _node_flags;
+        std::vector<op_id> _node_def;
+
+        /* Per-operation data, where the sources of operation "i" are
+         * stored in "_op_src[_op_src_offset[i]]" up to (but not
+         * including) "_op_src[_op_src_offset[i+1]]". */
+        std::vector<libflo::opcode> _op_code;
+        std::vector<node_id> _op_dest;
+        std::vector<uint32_t> _op_src_offset;
+        std::vector<node_id> _op_src;
+        std::vector<operation_ptr> _op_ptr;
+        std::vector<bool> _op_live;
+        size_t _live_op_count;
+
+        /* Every operand slot (an index into "_op_src") is threaded
+         * onto a doubly-linked list of the uses of the node it reads.
+         * The links live in flat arrays alongside the operands, so
+         * rewriting an operand takes constant time and never
+         * allocates. */
+        std::vector<op_id> _slot_op;
+        std::vector<uint32_t> _use_next;
+        std::vector<uint32_t> _use_prev;
+        std::vector<uint32_t> _node_first_use;
+        std::vector<uint32_t> _node_use_count;
+
+        /* Bumped every time the graph is changed. */
+        size_t _version;
+
+        /* The order operations are emitted in, if it's been set by
+         * "set_order()".  Operations created after that (which have
+         * IDs from "_order_end" on) are emitted after all of these,
+         * in ID order. */
+        std::vector<op_id> _order;
+        op_id _order_end;
+
+        /* A log of the operations that changed since it was last
+         * cleared.  Nothing is logged while the graph is first being
+         * built. */
+        std::vector<op_id> _touched;
+        bool _log_touched;
+
+        /* Allows the original flo nodes to be found. */
+        std::unordered_map<const node*, node_id> _ptr2id;
+
+        /* Constants with the same value and width are all the same
+         * node, no matter how many times they were written out in
+         * the flo (or created by a pass), which means that comparing
+         * two constants is just comparing their IDs.  These are
+         * keyed by "value'width". */
+        std::unordered_map<std::string, node_id> _const2id;
+
+        enum {
+            FLAG_MEM = 1,
+            FLAG_CONST = 2,
+            FLAG_KNOWN_WIDTH = 4,
+        };
+
+    public:
+        /* Builds a dense copy of the given flo. */
+        dense_graph(const flo_ptr& graph);
+
+    public:
+        size_t node_count(void) const { return _node_width.size(); }
+        size_t op_count(void) const { return _op_code.size(); }
+
+        /* Accessors for node data. */
+        const char *name(node_id n) const
+            { return (_node_ptr[n] == NULL) ? NULL : _node_ptr[n]->name().c_str(); }
+        bool is_mem(node_id n) const { return _node_flags[n] & FLAG_MEM; }
+        bool is_const(node_id n) const { return _node_flags[n] & FLAG_CONST; }
+        bool known_width(node_id n) const
+            { return _node_flags[n] & FLAG_KNOWN_WIDTH; }
+        size_t width(node_id n) const { return _node_width[n]; }
+
+        /* Returns the operation that writes a node, or "none" if
+         * there isn't one (inputs, constants, and such). */
+        op_id def(node_id n) const { return _node_def[n]; }
+
+        /* Iterates over every operation that reads a node. */
+        use_range uses(node_id n) const
+            { return use_range(use_iterator(this, _node_first_use[n])); }
+        size_t use_count(node_id n) const { return _node_use_count[n]; }
+
+        /* Accessors for operation data.  IDs of erased operations
+         * stay valid, but they're no longer live. */
+        bool is_live(op_id o) const { return _op_live[o]; }
+        size_t live_op_count(void) const { return _live_op_count; }
+        libflo::opcode opcode(op_id o) const { return _op_code[o]; }
+        node_id dest(op_id o) const { return _op_dest[o]; }
+        const node_id *sources_begin(op_id o) const
+            { return _op_src.data() + _op_src_offset[o]; }
+        const node_id *sources_end(op_id o) const
+            { return _op_src.data() + _op_src_offset[o+1]; }
+        size_t source_count(op_id o) const
+            { return _op_src_offset[o+1] - _op_src_offset[o]; }
+        node_id source(op_id o, size_t i) const
+            { return _op_src[_op_src_offset[o] + i]; }
+
+        /* Changes every time the graph is modified, which allows
+         * callers to tell if anything happened. */
+        size_t version(void) const { return _version; }
+
+        /* Lists the operations that were added, erased or given new
+         * sources since the log was last cleared, along with the
+         * definition of every node whose uses changed and every
+         * reader of a node whose definition changed.  Operations can
+         * show up more than once.  This lets callers work out which
+         * parts of the graph a change could have affected. */
+        const std::vector<op_id>& touched(void) const { return _touched; }
+        void clear_touched(void) { _touched.clear(); }
+
+        /* Maps between IDs and the flo's nodes.  Operations that were
+         * created or modified in place don't have a flo operation
+         * until the graph is converted back. */
+        node_id lookup(const node_ptr& n) const;
+        const node_ptr& node_at(node_id n) const { return _node_ptr[n]; }
+        const operation_ptr& op_at(op_id o) const { return _op_ptr[o]; }
+
+    public:
+        /* Creates a new, unnamed node that has the same width as the
+         * given one. */
+        node_id add_temp(node_id t);
+
+        /* Returns the constant node with the given value (which is
+         * also its name) and width, creating it if it doesn't
+         * already exist. */
+        node_id add_const(const std::string& value, size_t width);
+
+        /* Appends a new operation to the graph, which becomes the
+         * definition of "dest". */
+        op_id add_op(node_id dest,
+                     libflo::opcode opcode,
+                     const std::vector<node_id>& sources);
+
+        /* Removes an operation from the graph: it no longer defines
+         * or uses anything. */
+        void erase_op(op_id o);
+
+        /* Changes a single source of an operation. */
+        void set_source(op_id o, size_t i, node_id n);
+
+        /* Makes every operation that reads "from" read "to" instead,
+         * returning the number of operands that were changed. */
+        size_t replace_all_uses(node_id from, node_id to);
+
+        /* Changes the order that live operations are emitted in,
+         * without changing what any of them compute.  "order" must
+         * list every live operation exactly once. */
+        void set_order(const std::vector<op_id>& order);
+
+        /* Lists every live operation in the order it'll be emitted:
+         * ID order unless "set_order()" has been called. */
+        std::vector<op_id> emission_order(void) const;
+
+    public:
+        /* Converts this graph back into a flo, emitting either every
+         * live operation (in emission order) or just the given list
+         * of operations (in the given order).  Operations that
+         * weren't changed are reused rather than being copied. */
+        flo_ptr to_flo(void);
+        flo_ptr to_flo(const std::vector<op_id>& ops);
+
+    private:
+        node_id add_node(const node_ptr& n);
+        const node_ptr& materialize(node_id n);
+        void link_use(uint32_t slot);
+        void unlink_use(uint32_t slot);
+        void touch(op_id o);
+        void touch_def(node_id n) { touch(_node_def[n]); }
+        void touch_uses(node_id n);
+    };
+}
+
+#endif
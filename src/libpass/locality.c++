@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "locality.h++"
+#include <vector>
+using namespace libpass;
+
+locality::locality(const dense_graph& graph)
+    : _uses(0),
+      _average(0),
+      _max(0)
+{
+    typedef dense_graph::node_id node_id;
+    typedef dense_graph::op_id op_id;
+
+    /* Works out where each operation ends up once it's emitted. */
+    std::vector<size_t> position(graph.op_count(), 0);
+    size_t next = 0;
+    for (const auto& o: graph.emission_order())
+        position[o] = next++;
+
+    double total = 0;
+    for (op_id o = 0; o < graph.op_count(); ++o) {
+        if (graph.is_live(o) == false)
+            continue;
+
+        for (auto it = graph.sources_begin(o); it != graph.sources_end(o); ++it) {
+            node_id s = *it;
+            op_id d = graph.def(s);
+            if (d == dense_graph::none || d == o)
+                continue;
+
+            size_t distance = (position[o] > position[d])
+                ? position[o] - position[d]
+                : position[d] - position[o];
+
+            _uses++;
+            total += distance;
+            if (distance > _max)
+                _max = distance;
+        }
+    }
+
+    if (_uses > 0)
+        _average = total / (double)_uses;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPASS__LOCALITY_HXX
+#define LIBPASS__LOCALITY_HXX
+
+#include "dense_graph.h++"
+
+namespace libpass {
+    /* Measures how far apart values are produced and consumed in the
+     * order a graph's operations will be emitted: for every operand
+     * that's written by another operation, the distance (in
+     * operations) between that operation and the one reading it.
+     * Smaller distances mean a node's value is more likely to still
+     * be in the cache when it's read. */
+    class locality {
+    private:
+        size_t _uses;
+        double _average;
+        size_t _max;
+
+    public:
+        locality(const dense_graph& graph);
+
+    public:
+        /* The number of operands that were measured. */
+        size_t uses(void) const { return _uses; }
+
+        /* The average and largest def-to-use distance. */
+        double average(void) const { return _average; }
+        size_t max(void) const { return _max; }
+    };
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic_depth.h++"
+#include <libflo/opcode.h++>
+using namespace libpass;
+
+/* Returns the depth that an operation adds on top of its deepest
+ * source, or -1 if it starts a new path entirely. */
+static int added_depth(const libflo::opcode& op)
+{
+    switch (op) {
+    case libflo::opcode::REG:
+    case libflo::opcode::IN:
+        return -1;
+
+    case libflo::opcode::MOV:
+    case libflo::opcode::OUT:
+        return 0;
+
+    default:
+        return 1;
+    }
+}
+
+logic_depth::logic_depth(const dense_graph& graph)
+    : _depth(graph.node_count(), 0),
+      _max(0),
+      _average(0)
+{
+    typedef dense_graph::op_id op_id;
+
+    /* Depths are filled in by a depth-first walk from every node.  An
+     * explicit stack is used because the paths in large designs are
+     * much deeper than the C stack would allow.  A node that's found
+     * while it's still on the stack is part of a combinational loop,
+     * which is broken by treating the back edge as depth zero. */
+    enum { NEW, ACTIVE, DONE };
+    std::vector<uint8_t> state(graph.node_count(), NEW);
+    std::vector<std::pair<node_id, size_t>> stack;
+
+    for (node_id root = 0; root < graph.node_count(); ++root) {
+        if (state[root] != NEW)
+            continue;
+
+        stack.push_back(std::make_pair(root, 0));
+        state[root] = ACTIVE;
+
+        while (stack.size() > 0) {
+            auto& top = stack.back();
+            node_id n = top.first;
+            op_id def = graph.def(n);
+
+            /* Nodes that aren't computed by anything, or that start a
+             * new path, are depth zero. */
+            if (def == dense_graph::none || added_depth(graph.opcode(def)) < 0) {
+                _depth[n] = 0;
+                state[n] = DONE;
+                stack.pop_back();
+                continue;
+            }
+
+            /* Descend into the next source that hasn't been visited
+             * yet. */
+            if (top.second < graph.source_count(def)) {
+                node_id s = graph.source(def, top.second++);
+                if (state[s] == NEW) {
+                    state[s] = ACTIVE;
+                    stack.push_back(std::make_pair(s, 0));
+                }
+                continue;
+            }
+
+            /* Every source is done, so this node's depth is known. */
+            uint32_t deepest = 0;
+            for (auto it = graph.sources_begin(def); it != graph.sources_end(def); ++it)
+                if (state[*it] == DONE && _depth[*it] > deepest)
+                    deepest = _depth[*it];
+
+            _depth[n] = deepest + added_depth(graph.opcode(def));
+            state[n] = DONE;
+            stack.pop_back();
+        }
+    }
+
+    size_t count = 0, total = 0;
+    for (node_id n = 0; n < graph.node_count(); ++n) {
+        if (graph.def(n) == dense_graph::none)
+            continue;
+
+        count++;
+        total += _depth[n];
+        if (_depth[n] > _max)
+            _max = _depth[n];
+    }
+
+    if (count > 0)
+        _average = (double)total / (double)count;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPASS__LOGIC_DEPTH_HXX
+#define LIBPASS__LOGIC_DEPTH_HXX
+
+#include "dense_graph.h++"
+#include <vector>
+
+namespace libpass {
+    /* Computes the combinational depth of every node in a graph:
+     * the number of operations on the longest path from a register,
+     * an input, or a constant to that node.  MOVs and OUTs are free,
+     * as they don't compute anything. */
+    class logic_depth {
+        typedef dense_graph::node_id node_id;
+
+    private:
+        std::vector<uint32_t> _depth;
+        size_t _max;
+        double _average;
+
+    public:
+        logic_depth(const dense_graph& graph);
+
+    public:
+        /* The depth of a single node. */
+        size_t depth(node_id n) const { return _depth[n]; }
+
+        /* The deepest node, and the average depth of every node that
+         * is written by an operation. */
+        size_t max(void) const { return _max; }
+        double average(void) const { return _average; }
+    };
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h++"
+using namespace libpass;
+
+/* Each thread gets roughly this many chunks of a loop, which trades
+ * off the cost of grabbing a chunk against balancing the load. */
+static const size_t chunks_per_thread = 16;
+
+static size_t default_count = 1;
+
+thread_pool::thread_pool(size_t size)
+    : _threads(),
+      _lock(),
+      _wake(),
+      _done(),
+      _job(NULL),
+      _count(0),
+      _chunk(1),
+      _next(0),
+      _busy(0),
+      _generation(0),
+      _exit(false)
+{
+    for (size_t i = 1; i < size; ++i)
+        _threads.push_back(std::thread(&thread_pool::worker, this));
+}
+
+thread_pool::~thread_pool(void)
+{
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _exit = true;
+    }
+    _wake.notify_all();
+
+    for (auto& thread: _threads)
+        thread.join();
+}
+
+void thread_pool::parallel_for(size_t count, const job_t& job)
+{
+    /* There's no point in waking anyone up for a single thread's
+     * worth of work. */
+    if (_threads.size() == 0 || count <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _job = &job;
+        _count = count;
+        _chunk = count / (size() * chunks_per_thread);
+        if (_chunk == 0)
+            _chunk = 1;
+        _next.store(0);
+        _busy = _threads.size();
+        _generation++;
+    }
+    _wake.notify_all();
+
+    /* The calling thread helps out too, and then waits for everyone
+     * else to finish their last chunk. */
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(_lock);
+    while (_busy > 0)
+        _done.wait(lock);
+    _job = NULL;
+}
+
+void thread_pool::run_chunks(void)
+{
+    while (true) {
+        size_t start = _next.fetch_add(_chunk);
+        if (start >= _count)
+            return;
+
+        size_t end = start + _chunk;
+        if (end > _count)
+            end = _count;
+
+        for (size_t i = start; i < end; ++i)
+            (*_job)(i);
+    }
+}
+
+void thread_pool::worker(void)
+{
+    size_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            while (_exit == false && _generation == seen_generation)
+                _wake.wait(lock);
+
+            if (_exit == true)
+                return;
+
+            seen_generation = _generation;
+        }
+
+        run_chunks();
+
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _busy--;
+        }
+        _done.notify_all();
+    }
+}
+
+void libpass::set_thread_count(size_t count)
+{
+    if (count == 0)
+        count = 1;
+    if (count > max_thread_count)
+        count = max_thread_count;
+    default_count = count;
+}
+
+size_t libpass::thread_count(void)
+{
+    return default_count;
+}
+
+thread_pool& libpass::default_thread_pool(void)
+{
+    static thread_pool pool(default_count);
+    return pool;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPASS__THREAD_POOL_HXX
+#define LIBPASS__THREAD_POOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libpass {
+    /* A fixed set of worker threads that can run the iterations of a
+     * loop in parallel.  Iterations are handed out in small chunks
+     * from a shared counter, so threads that finish early keep
+     * pulling work rather than sitting idle. */
+    class thread_pool {
+    public:
+        typedef std::function<void(size_t)> job_t;
+
+    private:
+        std::vector<std::thread> _threads;
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::condition_variable _done;
+
+        /* The loop that's currently being run. */
+        const job_t *_job;
+        size_t _count;
+        size_t _chunk;
+        std::atomic<size_t> _next;
+
+        /* The number of workers still running the current loop, and
+         * a counter that tells workers a new loop has started. */
+        size_t _busy;
+        size_t _generation;
+        bool _exit;
+
+    public:
+        /* Creates a pool that runs loops on "size" threads in total,
+         * one of which is always the caller's. */
+        thread_pool(size_t size);
+        ~thread_pool(void);
+
+    public:
+        size_t size(void) const { return _threads.size() + 1; }
+
+        /* Calls "job" once for every integer in [0, count), returning
+         * once they've all finished.  The order in which iterations
+         * run isn't defined, so anything that needs to be
+         * deterministic should write its results into a slot indexed
+         * by the iteration. */
+        void parallel_for(size_t count, const job_t& job);
+
+    private:
+        void run_chunks(void);
+        void worker(void);
+    };
+
+    /* The pool shared by every pass, which has a single thread unless
+     * a different count was asked for before it was first used.
+     * Counts are clamped to between 1 and "max_thread_count". */
+    static const size_t max_thread_count = 1024;
+    void set_thread_count(size_t count);
+    size_t thread_count(void);
+    thread_pool& default_thread_pool(void);
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "union_find.h++"
+using namespace libpass;
+
+union_find::union_find(size_t size)
+    : _parent(size),
+      _rank(size, 0)
+{
+    for (size_t i = 0; i < size; ++i)
+        _parent[i] = i;
+}
+
+uint32_t union_find::find(uint32_t x)
+{
+    uint32_t root = x;
+    while (_parent[root] != root)
+        root = _parent[root];
+
+    /* Point every node along the path straight at the root, so the
+     * next lookup is fast. */
+    while (_parent[x] != root) {
+        uint32_t next = _parent[x];
+        _parent[x] = root;
+        x = next;
+    }
+
+    return root;
+}
+
+void union_find::unite(uint32_t a, uint32_t b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return;
+
+    if (_rank[a] < _rank[b]) {
+        _parent[a] = b;
+    } else if (_rank[a] > _rank[b]) {
+        _parent[b] = a;
+    } else {
+        _parent[b] = a;
+        _rank[a]++;
+    }
+}
+
+concurrent_union_find::concurrent_union_find(size_t size)
+    : _parent(size)
+{
+    for (size_t i = 0; i < size; ++i)
+        _parent[i].store(i, std::memory_order_relaxed);
+}
+
+uint32_t concurrent_union_find::find(uint32_t x)
+{
+    while (true) {
+        uint32_t p = _parent[x].load(std::memory_order_relaxed);
+        if (p == x)
+            return x;
+
+        /* Path halving: try to skip "x" over its parent.  It doesn't
+         * matter if this fails, someone else just got there first. */
+        uint32_t gp = _parent[p].load(std::memory_order_relaxed);
+        if (gp != p)
+            _parent[x].compare_exchange_weak(p, gp,
+                                             std::memory_order_relaxed);
+        x = gp;
+    }
+}
+
+void concurrent_union_find::unite(uint32_t a, uint32_t b)
+{
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return;
+
+        if (a < b) {
+            uint32_t t = a;
+            a = b;
+            b = t;
+        }
+
+        /* "a" is a root right now, but another thread might link it
+         * somewhere before we do -- in that case just try again from
+         * the new roots. */
+        uint32_t expected = a;
+        if (_parent[a].compare_exchange_weak(expected, b,
+                                             std::memory_order_relaxed))
+            return;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPASS__UNION_FIND_HXX
+#define LIBPASS__UNION_FIND_HXX
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace libpass {
+    /* A disjoint-set forest over the integers [0, size), using both
+     * path compression and union by rank. */
+    class union_find {
+    private:
+        std::vector<uint32_t> _parent;
+        std::vector<uint8_t> _rank;
+
+    public:
+        union_find(size_t size);
+
+    public:
+        /* Returns the representative of the set that contains "x". */
+        uint32_t find(uint32_t x);
+
+        /* Merges the sets that contain "a" and "b". */
+        void unite(uint32_t a, uint32_t b);
+    };
+
+    /* The same thing as above, but safe to call from many threads at
+     * once.  Ranks can't be maintained without locking, so instead
+     * the root with the larger index is always linked under the one
+     * with the smaller index, which still guarantees the forest stays
+     * acyclic.  Finds use path halving. */
+    class concurrent_union_find {
+    private:
+        std::vector<std::atomic<uint32_t>> _parent;
+
+    public:
+        concurrent_union_find(size_t size);
+
+    public:
+        uint32_t find(uint32_t x);
+        void unite(uint32_t a, uint32_t b);
+    };
+}
+
+#endif
@@ -19,19 +19,79 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
-#include "pass_list.h++"
-#include "pass_number.h++"
+#include <stdlib.h>
+#include "pass_driver.h++"
+#include "pass_stats.h++"
 #include "flo.h++"
+#include "flo_writer.h++"
+#include <libpass/connected_components.h++>
+#include <libpass/locality.h++>
+#include <libpass/logic_depth.h++>
+#include <libpass/thread_pool.h++>
 #include "version.h"
 
+/* Prints out the combinational depth of a design. */
+static void write_depth_report(const char *when,
+                               const libpass::dense_graph& graph)
+{
+    libpass::logic_depth depth(graph);
+
+    fprintf(stderr, "Logic depth %s: max " SIZET_FORMAT ", average %.2f\n",
+            when,
+            depth.max(),
+            depth.average()
+        );
+}
+
+/* Prints out how far apart values are written and read. */
+static void write_locality_report(const char *when,
+                                  const libpass::dense_graph& graph)
+{
+    libpass::locality locality(graph);
+
+    fprintf(stderr, "Def-to-use distance %s: max " SIZET_FORMAT
+            ", average %.2f\n",
+            when,
+            locality.max(),
+            locality.average()
+        );
+}
+
+/* Sets the number of threads from a "-j" argument, returning FALSE
+ * if it's not a positive number. */
+static bool parse_thread_count(const char *arg)
+{
+    if (*arg < '0' || *arg > '9')
+        return false;
+
+    char *end;
+    errno = 0;
+    unsigned long count = strtoul(arg, &end, 10);
+    if (*end != '\0' || errno != 0)
+        return false;
+    if (count == 0 || count > libpass::max_thread_count)
+        return false;
+
+    libpass::set_thread_count(count);
+    return true;
+}
+
 int main(int argc, const char **argv)
 {
     if ((argc == 1) || ((argc == 2) && (strcmp(argv[1], "--help") == 0))) {
         printf("flo-opt <in.flo> <out.flo>: Optimizes Flo files\n");
+        printf("  Either file may be '-' for standard input or output\n");
         printf("  --help: Prints this help text\n");
         printf("  --version: Prints the version of this program in use\n");
+        printf("  --time-passes: Prints the time taken by each pass\n");
+        printf("  --stats=<file.json>: Writes per-pass statistics as JSON\n");
+        printf("  --depth-report: Prints the logic depth before and after\n");
+        printf("  --locality-report: Prints the def-to-use distance before and after\n");
+        printf("  --check-components: Verifies every set of connected components\n");
+        printf("  -j <N>: Runs passes on up to N threads\n");
         return (argc == 1) ? 0 : 1;
     }
 
@@ -40,36 +100,114 @@ int main(int argc, const char **argv)
         return 0;
     }
 
-    /* Reads a Flo file from the input file. */
-    auto in_flo = flo::parse(argv[1]);
+    /* Options can show up anywhere, everything else is a filename. */
+    bool time_passes = false;
+    bool depth_report = false;
+    bool locality_report = false;
+    const char *stats_filename = NULL;
+    std::vector<const char *> filenames;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--time-passes") == 0)
+            time_passes = true;
+        else if (strcmp(argv[i], "--depth-report") == 0)
+            depth_report = true;
+        else if (strcmp(argv[i], "--locality-report") == 0)
+            locality_report = true;
+        else if (strcmp(argv[i], "--check-components") == 0)
+            libpass::set_check_components(true);
+        else if (strncmp(argv[i], "--stats=", strlen("--stats=")) == 0)
+            stats_filename = argv[i] + strlen("--stats=");
+        else if (strncmp(argv[i], "-j", strlen("-j")) == 0) {
+            const char *count = argv[i] + strlen("-j");
+            if (*count == '\0' && i + 1 < argc)
+                count = argv[++i];
+
+            if (parse_thread_count(count) == false) {
+                fprintf(stderr, "-j takes a thread count from 1 to "
+                        SIZET_FORMAT ", not '%s'\n",
+                        libpass::max_thread_count,
+                        count);
+                return 1;
+            }
+        } else
+            filenames.push_back(argv[i]);
+    }
+
+    if (filenames.size() != 2) {
+        fprintf(stderr, "flo-opt <in.flo> <out.flo>: Optimizes Flo files\n");
+        return 1;
+    }
 
-    /* Obtains the list of pass numbers and begins running each of
-     * them in order. */
-    std::shared_ptr<flo> cur = in_flo;
-    for (const auto& pass_number: all_pass_numbers())
-        for (const auto& pass: pass_list_lookup(pass_number))
-            cur = pass->operate(cur);
+    if (time_passes == true || stats_filename != NULL)
+        pass_stats_enable();
 
-    /* Just rename the flo file, it's now an output! */
-    auto out_flo = cur;
+    /* Reads a Flo file from the input file, where "-" is standard
+     * input.  libflo streams the file itself, so all that's needed
+     * here is a name it can open. */
+    auto in_flo = (strcmp(filenames[0], "-") == 0)
+        ? flo::parse("/dev/stdin")
+        : flo::parse(filenames[0]);
 
-    /* Creates a new output file and begins writing it out. */
-    auto out_file = fopen(argv[2], "w");
+    /* The design is converted into a dense_graph once, and every
+     * pass works on that. */
+    libpass::dense_graph graph(in_flo);
 
-    for (const auto& node : out_flo->nodes()) {
-        if (!node->is_mem())
-            continue;
+    if (depth_report == true)
+        write_depth_report("before", graph);
+    if (locality_report == true)
+        write_locality_report("before", graph);
+
+    /* Runs every pass the system knows about, in order. */
+    run_all_passes(graph);
 
-        fprintf(out_file, "%s = mem'" SIZET_FORMAT " " SIZET_FORMAT "\n",
-                node->name().c_str(),
-                node->width(),
-                node->depth()
-            );
+    if (depth_report == true)
+        write_depth_report("after", graph);
+    if (locality_report == true)
+        write_locality_report("after", graph);
+
+    if (time_passes == true)
+        pass_stats_write_report(stderr);
+
+    if (stats_filename != NULL) {
+        auto stats_file = fopen(stats_filename, "w");
+        if (stats_file == NULL) {
+            perror(stats_filename);
+            return 1;
+        }
+
+        /* A truncated stats file is just as bad as a truncated
+         * output, so it's checked the same way. */
+        pass_stats_write_json(stats_file);
+
+        bool ok = true;
+        if (fflush(stats_file) != 0 || ferror(stats_file) != 0)
+            ok = false;
+        if (fclose(stats_file) != 0)
+            ok = false;
+
+        if (ok == false) {
+            perror(stats_filename);
+            return 1;
+        }
     }
 
-    for (const auto& op : out_flo->operations()) {
-        for (const auto& node: op->operands()) {
-            if (node->known_width() == false) {
+    /* Converts the optimized graph back into a flo, it's now an
+     * output! */
+    auto out_flo = graph.to_flo();
+
+    /* Every operand needs a known width before it can be written
+     * out.  This is checked once per node rather than once per
+     * operand, and the offending operation is only searched for when
+     * something's actually wrong. */
+    for (const auto& node: out_flo->nodes()) {
+        if (node->known_width() == true)
+            continue;
+
+        for (const auto& op: out_flo->operations()) {
+            for (const auto& operand: op->operands()) {
+                if (operand != node)
+                    continue;
+
                 fprintf(stderr, "Unknown width of node '%s' in '%s'\n",
                         node->name().c_str(),
                         op->to_string().c_str()
@@ -77,11 +215,44 @@ int main(int argc, const char **argv)
                 abort();
             }
         }
+    }
 
-        op->writeln(out_file);
+    /* Creates a new output file and begins writing it out, where "-"
+     * is standard output. */
+    bool out_is_stdout = (strcmp(filenames[1], "-") == 0);
+    auto out_file = out_is_stdout ? stdout : fopen(filenames[1], "w");
+    if (out_file == NULL) {
+        perror(filenames[1]);
+        return 1;
     }
 
-    fclose(out_file);
+    /* Short writes (a full disk, or a closed pipe) show up either as
+     * a failed write from the buffer or as an error on the stream
+     * when it's flushed and closed, any of which means the output is
+     * truncated. */
+    bool ok;
+    {
+        flo_writer writer(out_file);
+
+        for (const auto& node: out_flo->nodes())
+            if (node->is_mem())
+                writer.write_mem(node);
+
+        for (const auto& op: out_flo->operations())
+            writer.write_op(op);
+
+        ok = writer.flush();
+    }
+
+    if (fflush(out_file) != 0 || ferror(out_file) != 0)
+        ok = false;
+    if (out_is_stdout == false && fclose(out_file) != 0)
+        ok = false;
+
+    if (ok == false) {
+        perror(filenames[1]);
+        return 1;
+    }
 
     return 0;
 }
@@ -20,6 +20,7 @@
  */
 
 #include "node.h++"
+#include <atomic>
 
 node::node(const std::string name,
            const libflo::unknown<size_t>& width,
@@ -34,12 +35,20 @@ node::node(const std::string name,
 
 std::shared_ptr<node> node::make_temp(const std::shared_ptr<node>& t)
 {
-    static size_t index = 0;
-    char name[1024];
-    snprintf(name, 1024, "OPT" SIZET_FORMAT, index++);
+    return make_temp(t->width_u());
+}
+
+std::shared_ptr<node> node::make_temp(const libflo::unknown<size_t>& w)
+{
+    static std::atomic<size_t> index(0);
+
+    /* The counter is atomic so this is safe to call from multiple
+     * threads, but passes that want deterministic names still need
+     * to create their temporaries in a deterministic order. */
+    std::string name = "OPT" + std::to_string(index.fetch_add(1));
 
     return std::make_shared<node>(name,
-                                  t->width_u(),
+                                  w,
                                   libflo::unknown<size_t>(),
                                   false,
                                   false,
@@ -40,6 +40,9 @@ public:
     /* Creates a temporary node from a template node, producing a new
      * node with a different name but the same width. */
     static std::shared_ptr<node> make_temp(const std::shared_ptr<node>& t);
+
+    /* Creates a temporary node of the given width. */
+    static std::shared_ptr<node> make_temp(const libflo::unknown<size_t>& w);
 };
 
 #endif
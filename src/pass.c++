@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "pass.h++"
+#include "pass_stats.h++"
+
+const pass::flo_ptr in_place_pass::operate(const flo_ptr& i) const
+{
+    libpass::dense_graph g(i);
+    operate_in_place(g);
+    return g.to_flo();
+}
+
+pass_timer::pass_timer(const char *name)
+    : _name(name),
+      _enabled(pass_stats_enabled()),
+      _start(0),
+      _allocations(0)
+{
+    if (_enabled == false)
+        return;
+
+    _allocations = pass_stats_allocations();
+    _start = pass_stats_now();
+}
+
+pass_timer::~pass_timer(void)
+{
+    stop();
+}
+
+void pass_timer::stop(void)
+{
+    if (_enabled == false)
+        return;
+    _enabled = false;
+
+    double seconds = pass_stats_now() - _start;
+    size_t allocations = pass_stats_allocations() - _allocations;
+    pass_stats_add_phase(_name, seconds, allocations);
+}
@@ -23,6 +23,7 @@
 #define PASS_HXX
 
 #include "flo.h++"
+#include <libpass/dense_graph.h++>
 
 /* Represents a single optimization pass. */
 class pass {
@@ -35,4 +36,46 @@ public:
     virtual const flo_ptr operate(const flo_ptr& i) const = 0;
 };
 
+/* A pass that rewrites a graph in place, touching only the
+ * operations it actually changes.  These can be run back-to-back on
+ * the same dense_graph without ever building a new flo, which is
+ * what the pass driver does for runs of them. */
+class in_place_pass: public pass {
+public:
+    /* Rewrites the given graph, returning TRUE if anything was
+     * changed. */
+    virtual bool operate_in_place(libpass::dense_graph& g) const = 0;
+
+    /* Returns TRUE if a change to the given operation (as logged by
+     * the graph's "touched()" list) could give this pass something
+     * new to do.  The pass driver only re-runs a pass when one of
+     * these has changed since it last ran, so passes that only look
+     * at some of the graph can say so here. */
+    virtual bool depends_on(const libpass::dense_graph& g __attribute__((unused)),
+                            libpass::dense_graph::op_id o __attribute__((unused))) const
+        { return true; }
+
+    /* Runs this pass on its own, by way of a dense_graph. */
+    virtual const flo_ptr operate(const flo_ptr& i) const;
+};
+
+/* Times a phase of a pass, from construction until destruction, and
+ * charges that time to the pass that's currently running.  This does
+ * nothing unless statistics have been requested, so it's fine to use
+ * inside loops. */
+class pass_timer {
+private:
+    const char *_name;
+    bool _enabled;
+    double _start;
+    size_t _allocations;
+
+public:
+    pass_timer(const char *name);
+    ~pass_timer(void);
+
+    /* Ends the phase before the timer goes out of scope. */
+    void stop(void);
+};
+
 #endif
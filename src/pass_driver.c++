@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "pass_driver.h++"
+#include "pass_list.h++"
+#include "pass_number.h++"
+#include "pass_stats.h++"
+#include <queue>
+
+/* A safety net: no run of in-place passes is allowed to execute more
+ * than this many passes (per pass in the run) before giving up on
+ * reaching a fixed point. */
+static const size_t max_runs_per_pass = 64;
+
+static void run_to_fixed_point(libpass::dense_graph& graph,
+                               const std::vector<const in_place_pass *>& passes,
+                               const pass_number& number)
+{
+    /* Every pass starts out on the worklist, in registration order.
+     * When a pass changes the graph every other pass gets put back on
+     * the list, but it's only actually run again if one of the
+     * operations that changed since it last ran is one it depends
+     * on. */
+    std::vector<bool> queued(passes.size(), true);
+    std::vector<bool> has_run(passes.size(), false);
+    std::vector<size_t> seen_touched(passes.size(), 0);
+    std::queue<size_t> worklist;
+    for (size_t i = 0; i < passes.size(); ++i)
+        worklist.push(i);
+
+    graph.clear_touched();
+
+    size_t runs = 0;
+    while (worklist.size() > 0) {
+        auto i = worklist.front(); worklist.pop();
+        queued[i] = false;
+
+        if (has_run[i] == true) {
+            const auto& touched = graph.touched();
+            bool dirty = false;
+            for (size_t t = seen_touched[i]; t < touched.size(); ++t) {
+                if (passes[i]->depends_on(graph, touched[t]) == true) {
+                    dirty = true;
+                    break;
+                }
+            }
+
+            seen_touched[i] = touched.size();
+            if (dirty == false)
+                continue;
+        }
+
+        if (runs++ >= max_runs_per_pass * passes.size()) {
+            fprintf(stderr, "WARNING: passes at number " SIZET_FORMAT
+                    " did not reach a fixed point\n",
+                    (size_t)number);
+            break;
+        }
+
+        pass_stats_begin(passes[i]->name(), number, graph);
+        bool changed = passes[i]->operate_in_place(graph);
+        pass_stats_end(graph);
+
+        /* A pass's own changes never make it run again, the same as
+         * any other pass that's already reached its fixed point. */
+        has_run[i] = true;
+        seen_touched[i] = graph.touched().size();
+
+        if (changed == false)
+            continue;
+
+        for (size_t j = 0; j < passes.size(); ++j) {
+            if (j == i || queued[j] == true)
+                continue;
+
+            queued[j] = true;
+            worklist.push(j);
+        }
+    }
+
+    graph.clear_touched();
+}
+
+void run_all_passes(libpass::dense_graph& graph)
+{
+    for (const auto& number: all_pass_numbers()) {
+        auto passes = pass_list_lookup(number);
+
+        size_t i = 0;
+        while (i < passes.size()) {
+            /* Gather up every consecutive in-place pass, they can all
+             * share one graph. */
+            std::vector<const in_place_pass *> run;
+            while (i < passes.size()) {
+                auto p = dynamic_cast<const in_place_pass *>(passes[i].get());
+                if (p == NULL)
+                    break;
+
+                run.push_back(p);
+                i++;
+            }
+
+            if (run.size() > 0) {
+                run_to_fixed_point(graph, run, number);
+                continue;
+            }
+
+            /* Anything else needs a flo, which means the graph has to
+             * be rebuilt from whatever it produces. */
+            auto cur = graph.to_flo();
+            pass_stats_begin(passes[i]->name(), number, cur);
+            cur = passes[i]->operate(cur);
+            pass_stats_end(cur);
+            graph = libpass::dense_graph(cur);
+            i++;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASS_DRIVER_HXX
+#define PASS_DRIVER_HXX
+
+#include <memory>
+#include "flo.h++"
+#include <libpass/dense_graph.h++>
+
+/* Runs every registered pass over a design, in pass number order.
+ * The design stays in a single dense_graph the whole time: passes
+ * that can operate in place rewrite it directly, and consecutive runs
+ * of them are iterated until none of them changes anything.  A pass
+ * is only re-run when some operation it depends on (see
+ * "in_place_pass::depends_on()") has changed since it last looked at
+ * the graph.  Only passes that need a flo cause it to be converted
+ * and rebuilt. */
+void run_all_passes(libpass::dense_graph& graph);
+
+#endif
@@ -30,7 +30,9 @@
 enum class pass_number {
     INIT,
     REBALANCE, /* Re-balances binary operations. */
+    GVN,       /* Merges equivalent operations and folds constants. */
     LATE_DCE,
+    SCHEDULE,  /* Orders operations for cache locality. */
     FINAL
 };
 
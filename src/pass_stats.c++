@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "pass_stats.h++"
+#include "alloc_count.h++"
+#include <mutex>
+#include <sys/resource.h>
+#include <time.h>
+
+static bool enabled = false;
+static std::vector<pass_stats> passes;
+static std::mutex phase_lock;
+static double begin_time;
+static size_t begin_allocations;
+static long begin_rss;
+
+void pass_stats_enable(void)
+{
+    enabled = true;
+    alloc_count_enable();
+}
+
+bool pass_stats_enabled(void)
+{
+    return enabled;
+}
+
+static void begin(const std::string& name,
+                  const pass_number& number,
+                  size_t nodes,
+                  size_t ops)
+{
+    pass_stats s;
+    s.name = name;
+    s.number = number;
+    s.seconds = 0;
+    s.nodes_before = nodes;
+    s.nodes_after = 0;
+    s.ops_before = ops;
+    s.ops_after = 0;
+    s.peak_rss_delta_kb = 0;
+    s.allocations = 0;
+    passes.push_back(s);
+
+    /* These are sampled last so the counting above doesn't end up
+     * being charged to the pass. */
+    begin_rss = pass_stats_peak_rss_kb();
+    begin_allocations = pass_stats_allocations();
+    begin_time = pass_stats_now();
+}
+
+/* Stops the clock on the current pass and returns it, so the caller
+ * can fill in the sizes without those being timed. */
+static pass_stats& end(void)
+{
+    double end_time = pass_stats_now();
+    size_t end_allocations = pass_stats_allocations();
+    long end_rss = pass_stats_peak_rss_kb();
+
+    auto& s = passes.back();
+    s.seconds = end_time - begin_time;
+    s.allocations = end_allocations - begin_allocations;
+    s.peak_rss_delta_kb = end_rss - begin_rss;
+    return s;
+}
+
+void pass_stats_begin(const std::string& name,
+                      const pass_number& number,
+                      const std::shared_ptr<flo>& before)
+{
+    if (enabled == false)
+        return;
+
+    begin(name, number,
+          before->nodes().size(),
+          before->operations().size());
+}
+
+void pass_stats_begin(const std::string& name,
+                      const pass_number& number,
+                      const libpass::dense_graph& before)
+{
+    if (enabled == false)
+        return;
+
+    begin(name, number, before.node_count(), before.live_op_count());
+}
+
+void pass_stats_end(const std::shared_ptr<flo>& after)
+{
+    if (enabled == false)
+        return;
+
+    auto& s = end();
+    s.nodes_after = after->nodes().size();
+    s.ops_after = after->operations().size();
+}
+
+void pass_stats_end(const libpass::dense_graph& after)
+{
+    if (enabled == false)
+        return;
+
+    auto& s = end();
+    s.nodes_after = after.node_count();
+    s.ops_after = after.live_op_count();
+}
+
+void pass_stats_add_phase(const std::string& name,
+                          double seconds,
+                          size_t allocations)
+{
+    if (enabled == false || passes.size() == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(phase_lock);
+
+    for (auto& phase: passes.back().phases) {
+        if (phase.name == name) {
+            phase.count++;
+            phase.seconds += seconds;
+            phase.allocations += allocations;
+            return;
+        }
+    }
+
+    phase_stats p;
+    p.name = name;
+    p.count = 1;
+    p.seconds = seconds;
+    p.allocations = allocations;
+    passes.back().phases.push_back(p);
+}
+
+const std::vector<pass_stats>& pass_stats_list(void)
+{
+    return passes;
+}
+
+double pass_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+size_t pass_stats_allocations(void)
+{
+    return alloc_count();
+}
+
+long pass_stats_peak_rss_kb(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss;
+}
+
+/* SIZET_FORMAT can't be given a field width, so the report's
+ * columns are formatted into a buffer first. */
+struct size_column {
+    char text[32];
+
+    size_column(size_t n)
+        {
+            snprintf(text, sizeof(text), SIZET_FORMAT, n);
+        }
+};
+
+void pass_stats_write_report(FILE *f)
+{
+    double total = 0;
+    for (const auto& s: passes)
+        total += s.seconds;
+
+    fprintf(f, "===--- Pass execution timing report ---===\n");
+    fprintf(f, "  Total: %.4f seconds\n\n", total);
+    fprintf(f, "  %10s %6s %12s %12s %10s %12s  %s\n",
+            "Wall (s)", "%", "Ops before", "Ops after",
+            "RSS (kB)", "Allocs", "Pass");
+
+    for (const auto& s: passes) {
+        fprintf(f, "  %10.4f %5.1f%% %12s %12s %10ld %12s  %s\n",
+                s.seconds,
+                (total > 0) ? (100.0 * s.seconds / total) : 0.0,
+                size_column(s.ops_before).text,
+                size_column(s.ops_after).text,
+                s.peak_rss_delta_kb,
+                size_column(s.allocations).text,
+                s.name.c_str()
+            );
+
+        for (const auto& p: s.phases) {
+            fprintf(f, "  %10.4f %6s %12s %12s %10s %12s    %s (x"
+                    SIZET_FORMAT ")\n",
+                    p.seconds, "", "", "", "",
+                    size_column(p.allocations).text,
+                    p.name.c_str(),
+                    p.count
+                );
+        }
+    }
+}
+
+/* Writes a string out as a JSON string literal. */
+static void write_json_string(FILE *f, const std::string& s)
+{
+    fputc('"', f);
+    for (const auto& c: s) {
+        switch (c) {
+        case '"':  fputs("\\\"", f); break;
+        case '\\': fputs("\\\\", f); break;
+        case '\n': fputs("\\n", f);  break;
+        case '\t': fputs("\\t", f);  break;
+        default:
+            if ((unsigned char)c < 0x20)
+                fprintf(f, "\\u%04x", c);
+            else
+                fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+void pass_stats_write_json(FILE *f)
+{
+    fprintf(f, "{\n  \"passes\": [");
+
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const auto& s = passes[i];
+
+        fprintf(f, "%s\n    {\n", (i == 0) ? "" : ",");
+        fprintf(f, "      \"name\": ");
+        write_json_string(f, s.name);
+        fprintf(f, ",\n");
+        fprintf(f, "      \"pass_number\": " SIZET_FORMAT ",\n", (size_t)s.number);
+        fprintf(f, "      \"seconds\": %.6f,\n", s.seconds);
+        fprintf(f, "      \"nodes_before\": " SIZET_FORMAT ",\n", s.nodes_before);
+        fprintf(f, "      \"nodes_after\": " SIZET_FORMAT ",\n", s.nodes_after);
+        fprintf(f, "      \"ops_before\": " SIZET_FORMAT ",\n", s.ops_before);
+        fprintf(f, "      \"ops_after\": " SIZET_FORMAT ",\n", s.ops_after);
+        fprintf(f, "      \"ops_per_second\": %.1f,\n",
+                (s.seconds > 0) ? (double)s.ops_before / s.seconds : 0.0);
+        fprintf(f, "      \"peak_rss_delta_kb\": %ld,\n", s.peak_rss_delta_kb);
+        fprintf(f, "      \"allocations\": " SIZET_FORMAT ",\n", s.allocations);
+        fprintf(f, "      \"phases\": [");
+
+        for (size_t j = 0; j < s.phases.size(); ++j) {
+            const auto& p = s.phases[j];
+
+            fprintf(f, "%s\n        { \"name\": ", (j == 0) ? "" : ",");
+            write_json_string(f, p.name);
+            fprintf(f, ", \"count\": " SIZET_FORMAT ", \"seconds\": %.6f, "
+                    "\"allocations\": " SIZET_FORMAT " }",
+                    p.count, p.seconds, p.allocations);
+        }
+
+        fprintf(f, "%s]\n    }", (s.phases.size() == 0) ? "" : "\n      ");
+    }
+
+    fprintf(f, "\n  ],\n");
+    fprintf(f, "  \"peak_rss_kb\": %ld\n", pass_stats_peak_rss_kb());
+    fprintf(f, "}\n");
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASS_STATS_HXX
+#define PASS_STATS_HXX
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "pass_number.h++"
+#include "flo.h++"
+#include <libpass/dense_graph.h++>
+
+/* The statistics gathered for a single phase of a pass, as timed by
+ * a "pass_timer".  Phases that run more than once are accumulated
+ * together. */
+struct phase_stats {
+    std::string name;
+    size_t count;
+    double seconds;
+    size_t allocations;
+};
+
+/* The statistics gathered for a single run of a pass. */
+struct pass_stats {
+    std::string name;
+    pass_number number;
+    double seconds;
+    size_t nodes_before, nodes_after;
+    size_t ops_before, ops_after;
+    long peak_rss_delta_kb;
+    size_t allocations;
+    std::vector<phase_stats> phases;
+};
+
+/* Statistics are only gathered when they've been asked for, so the
+ * common case doesn't pay for any of this. */
+void pass_stats_enable(void);
+bool pass_stats_enabled(void);
+
+/* Brackets the execution of a single pass, which can either operate
+ * on a flo or in place on a dense_graph. */
+void pass_stats_begin(const std::string& name,
+                      const pass_number& number,
+                      const std::shared_ptr<flo>& before);
+void pass_stats_begin(const std::string& name,
+                      const pass_number& number,
+                      const libpass::dense_graph& before);
+void pass_stats_end(const std::shared_ptr<flo>& after);
+void pass_stats_end(const libpass::dense_graph& after);
+
+/* Adds the time taken by a phase to the pass that's currently
+ * running.  This is safe to call from multiple threads. */
+void pass_stats_add_phase(const std::string& name,
+                          double seconds,
+                          size_t allocations);
+
+/* Returns every pass that has run so far, in order. */
+const std::vector<pass_stats>& pass_stats_list(void);
+
+/* Helpers for measuring things. */
+double pass_stats_now(void);
+size_t pass_stats_allocations(void);
+long pass_stats_peak_rss_kb(void);
+
+/* Writes out the statistics, either as a human-readable table or as
+ * JSON. */
+void pass_stats_write_report(FILE *f);
+void pass_stats_write_json(FILE *f);
+
+#endif
@@ -23,16 +23,24 @@
 #include <pass_list.h++>
 #include <libflo/opcode.h++>
 #include <libpass/connected_components.h++>
+#include <libpass/logic_depth.h++>
+#include <libpass/thread_pool.h++>
+#include <algorithm>
 #include <queue>
 
-typedef std::shared_ptr<node> node_ptr;
-typedef std::shared_ptr<operation> operation_ptr;
-typedef std::shared_ptr<flo> flo_ptr;
-
 static void init(void) __attribute__((constructor));
 
-class balance_bitwise_op: public pass {
+/* Rebalances trees of a single associative and commutative operation
+ * so that the result is available as early as possible.  Despite the
+ * name this handles arithmetic too.  Only trees in which every
+ * operation and operand has the same width are touched, as that's
+ * when nothing gets truncated in the middle of the tree and so it can
+ * be freely reassociated. */
+class balance_bitwise_op: public in_place_pass {
 private:
+    typedef libpass::dense_graph::node_id node_id;
+    typedef libpass::dense_graph::op_id op_id;
+
     const libflo::opcode _opcode;
     const std::string _name;
 
@@ -48,9 +56,24 @@ public:
             return _name;
         }
 
-    const flo_ptr operate(const flo_ptr& input) const
+    /* Which trees exist only changes when an operation of this
+     * pass's type changes (which includes the ones whose readers
+     * changed).  Other passes can still make a tree's inputs
+     * shallower, which could in theory allow a slightly better
+     * tree, but that isn't worth recomputing the logic depth of the
+     * whole design after every unrelated change. */
+    bool depends_on(const libpass::dense_graph& graph, op_id op) const
+        {
+            return graph.opcode(op) == _opcode;
+        }
+
+    bool operate_in_place(libpass::dense_graph& graph) const
         {
-            auto output = flo::empty();
+            /* The depth of every node is needed to decide which
+             * inputs of a tree should be combined first. */
+            pass_timer depth_timer("logic_depth");
+            libpass::logic_depth depth(graph);
+            depth_timer.stop();
 
             /* Builds a list of the connected components, where a edge
              * is defined as an operation that matches the type this
@@ -60,130 +83,320 @@ public:
              * single node in their connected component (as they're
              * connected to nothing) and the rest of the ops will
              * have */
-            auto test_func = [&](const operation_ptr& op,
-                                 const node_ptr& from __attribute__((unused)),
-                                 const node_ptr& to __attribute__((unused)))
-                -> bool
+            libpass::connected_components::dense_test_func_t test_func =
+                [&](op_id op) -> bool
                 {
-                    return op->op() == _opcode;
+                    return is_tree_op(graph, op);
                 };
-            libpass::connected_components comp(input, test_func);
+            pass_timer find_timer("connected_components");
+            libpass::connected_components comp(graph, test_func,
+                                               libpass::thread_count());
+            find_timer.stop();
+
+            /* Every component is planned independently, so they're
+             * all planned in parallel.  The plans are then applied in
+             * component order, which is also when temporary nodes get
+             * created -- that way the output doesn't depend on how
+             * many threads were used. */
+            const auto& ids = comp.component_ids();
+            std::vector<std::vector<rewrite>> plans(ids.size());
+
+            pass_timer plan_timer("plan_cc");
+            libpass::default_thread_pool().parallel_for(
+                ids.size(),
+                [&](size_t i) -> void
+                {
+                    plan_cc(plans[i], comp.op_ids(ids[i]), graph, depth);
+                });
+            plan_timer.stop();
 
-            for (const auto& id: comp.component_ids())
-                fill_cc(output, comp.ops(id));
+            pass_timer fill_timer("fill_cc");
+            bool changed = false;
+            for (auto& p: plans) {
+                for (const auto& r: p) {
+                    fill(graph, r);
+                    changed = true;
+                }
+                p = std::vector<rewrite>();
+            }
+            fill_timer.stop();
 
-            return output;
+            return changed;
         }
 
 private:
-    void fill_cc(flo_ptr& to_fill,
-                 const std::vector<operation_ptr>& comp) const
+    /* An operand of a rewritten tree: either a node that already
+     * exists or one of the temporaries created by the rewrite, by
+     * index. */
+    struct planned_node {
+        node_id existing;
+        size_t temp;
+    };
+
+    /* A single operation in a rewritten tree.  The result of step "i"
+     * is temporary "i", except for the last step which writes the
+     * tree's root. */
+    struct step {
+        planned_node a, b;
+    };
+
+    /* The complete rewrite of the tree under a single root.  Trees
+     * that are down to a single input are just a MOV from "only", and
+     * XOR trees whose inputs all cancel out are just a MOV from
+     * zero. */
+    struct rewrite {
+        op_id root;
+        std::vector<step> steps;
+        planned_node only;
+        bool zero;
+    };
+
+    /* A tree input that's waiting to be combined, ordered so that the
+     * shallowest comes out of a priority queue first.  Ties are
+     * broken by the order inputs were found in, which keeps the
+     * output deterministic. */
+    struct pending_input {
+        planned_node node;
+        size_t depth;
+        size_t order;
+
+        bool operator<(const pending_input& o) const
+            {
+                if (depth != o.depth)
+                    return depth > o.depth;
+                return order > o.order;
+            }
+    };
+
+    /* Returns TRUE if this operation is part of a tree that can be
+     * rebalanced. */
+    bool is_tree_op(const libpass::dense_graph& graph, op_id op) const
+        {
+            if (graph.opcode(op) != _opcode)
+                return false;
+            if (graph.source_count(op) != 2)
+                return false;
+
+            /* Trees can only be reassociated when nothing gets
+             * extended or truncated along the way: a narrow node in
+             * the middle of a tree drops the upper bits of everything
+             * below it, even for the bitwise operations. */
+            node_id d = graph.dest(op);
+            if (graph.known_width(d) == false)
+                return false;
+            for (auto it = graph.sources_begin(op); it != graph.sources_end(op); ++it) {
+                if (graph.known_width(*it) == false)
+                    return false;
+                if (graph.width(*it) != graph.width(d))
+                    return false;
+            }
+            return true;
+        }
+
+    /* Returns TRUE if a node is strictly inside a tree: it's computed
+     * by a tree operation and read by nothing but a single tree
+     * operation.  Everything else that a tree reads is one of its
+     * inputs, which means shared values are never duplicated. */
+    bool is_internal(const libpass::dense_graph& graph, node_id n) const
+        {
+            op_id def = graph.def(n);
+            if (def == libpass::dense_graph::none || is_tree_op(graph, def) == false)
+                return false;
+            if (graph.use_count(n) != 1)
+                return false;
+            return is_tree_op(graph, *graph.uses(n).begin());
+        }
+
+    /* Works out how to rewrite every tree in a single connected
+     * component, without touching the graph. */
+    void plan_cc(std::vector<rewrite>& to_fill,
+                 const libpass::connected_components::op_range& comp,
+                 const libpass::dense_graph& graph,
+                 const libpass::logic_depth& depth) const
         {
             /* Small connected components can't have anything done to
              * them so there's no point in bothering with any
              * optimization. */
-            if (comp.size() < 3) {
-                for (const auto& op: comp)
-                    to_fill->add_op(op);
+            if (comp.size() < 3)
                 return;
-            }
-            /* The only connected components that made it through that
-             * filter above are ones that match the opcode provided --
-             * that's a side effect of the operation being so
-             * small. */
-
-            /* Map a node to the operation that produces it. */
-            std::unordered_map<node_ptr, operation_ptr> node2binop;
-            std::unordered_map<node_ptr, operation_ptr> node2op;
-            for (const auto& op: comp) {
-                if (op->op() == _opcode)
-                    node2binop[op->d()] = op;
-                else
-                    node2op[op->d()] = op;
-            }
 
-            /* Walk through the list of operations trying to figure
-             * out which are outputs.  This is doen in two passes,
-             * which probably isn't the post efficient: essentially
-             * what happens is that we add every node to a map and
-             * then remove every node that is read by any operation in
-             * the tree.  The remaining nodes must be outputs. */
-            std::unordered_map<node_ptr, bool> is_output;
-            for (const auto& op: comp)
-                is_output[op->d()] = true;
-            for (const auto& op: comp)
-                for (const auto& source: op->sources())
-                    is_output[source] = false;
-
-            /* Now that we know which nodes are outputs of this
-             * connected component we need to go ahead and reconstruct
-             * the output nodes in a more efficient manner. */
             for (const auto& op: comp) {
-                /* Operations that aren't an outputs still need to be
-                 * emitted because they could be used by some other
-                 * part of the circuit.  It's expected that a dead
-                 * code elimination phase runs AFTER this, so that's
-                 * considered OK for now. */
-                /* FIXME: Actually do DCE. */
-                if (is_output[op->d()] == false) {
-                    to_fill->add_op(op);
+                /* Trees are rewritten from their roots, which are the
+                 * tree operations whose result is visible outside of
+                 * the tree.  Dead trees are left for dead code
+                 * elimination. */
+                if (is_tree_op(graph, op) == false)
+                    continue;
+                if (graph.use_count(graph.dest(op)) == 0)
+                    continue;
+                if (is_internal(graph, graph.dest(op)) == true)
                     continue;
-                }
 
                 /* Determine the set of nodes that are inputs to this
-                 * output.  These are just any nodes that aren't
-                 * constructed by anything. */
-                std::unordered_map<node_ptr, bool> in_input_set;
-                std::queue<node_ptr> input_set;
-                std::queue<operation_ptr> queue({op});
+                 * root, in the order they're found. */
+                std::vector<node_id> leaves;
+                std::queue<op_id> queue({op});
                 while (queue.size() > 0) {
                     auto cur = queue.front();
                     queue.pop();
 
-                    for (const auto source: cur->sources()) {
-                        auto l = node2binop.find(source);
-                        if (l != node2binop.end()) {
-                            queue.push(l->second);
-                        } else if (in_input_set[source] != true) {
-                            input_set.push(source);
-                            to_fill->add_op(node2op[source]);
-                            in_input_set[source] = true;
-                        }
+                    for (auto it = graph.sources_begin(cur); it != graph.sources_end(cur); ++it) {
+                        if (is_internal(graph, *it))
+                            queue.push(graph.def(*it));
+                        else
+                            leaves.push_back(*it);
                     }
                 }
 
+                auto inputs = merge_leaves(leaves);
+
                 /* Now that we've got the input set go ahead and
-                 * construct a balanced tree that computes that input
-                 * exactly. */
+                 * construct a tree that computes that input exactly.
+                 * This is built like a Huffman code: the two inputs
+                 * that arrive earliest are always combined first, so
+                 * late-arriving inputs end up close to the root. */
+                std::priority_queue<pending_input> input_set;
+                size_t order = 0;
+                for (const auto& leaf: inputs) {
+                    pending_input n;
+                    n.node.existing = leaf;
+                    n.node.temp = 0;
+                    n.depth = depth.depth(leaf);
+                    n.order = order++;
+                    input_set.push(n);
+                }
+
+                rewrite r;
+                r.root = op;
+                r.zero = (inputs.size() == 0);
                 while (input_set.size() > 1) {
-                    auto a = input_set.front(); input_set.pop();
-                    auto b = input_set.front(); input_set.pop();
-                    auto n = node::make_temp(a);
+                    auto a = input_set.top(); input_set.pop();
+                    auto b = input_set.top(); input_set.pop();
 
-                    auto op = std::make_shared<operation>(
-                        n,
-                        n->width_u(),
-                        _opcode,
-                        std::vector<node_ptr>({a, b})
-                        );
+                    step s;
+                    s.a = a.node;
+                    s.b = b.node;
 
+                    pending_input n;
+                    n.node.existing = libpass::dense_graph::none;
+                    n.node.temp = r.steps.size();
+                    n.depth = std::max(a.depth, b.depth) + 1;
+                    n.order = order++;
+
+                    r.steps.push_back(s);
                     input_set.push(n);
-                    to_fill->add_op(op);
                 }
+                size_t new_depth = 0;
+                if (r.zero == false) {
+                    r.only = input_set.top().node;
+                    new_depth = input_set.top().depth;
+                }
+
+                /* Trees that are already as shallow as they can be
+                 * are left alone, which is what lets this pass reach
+                 * a fixed point. */
+                size_t old_depth = depth.depth(graph.dest(op));
+                bool shallower = new_depth < old_depth;
+                bool smaller = inputs.size() < leaves.size();
+                if (shallower == false && smaller == false)
+                    continue;
+
+                to_fill.push_back(r);
+            }
+        }
+
+    /* Combines the inputs of a tree that are the same node, which
+     * depends on the operation: AND and OR are idempotent so repeats
+     * can just be dropped, repeats cancel in pairs for XOR, and ADD
+     * and MUL need every copy.  Inputs that survive stay in the order
+     * they were first found in. */
+    std::vector<node_id> merge_leaves(const std::vector<node_id>& leaves) const
+        {
+            bool idempotent = (_opcode == libflo::opcode::AND) ||
+                              (_opcode == libflo::opcode::OR);
+            bool cancels = (_opcode == libflo::opcode::XOR);
+            if (idempotent == false && cancels == false)
+                return leaves;
+
+            std::vector<std::pair<node_id, size_t>> sorted;
+            sorted.reserve(leaves.size());
+            for (size_t i = 0; i < leaves.size(); ++i)
+                sorted.push_back(std::make_pair(leaves[i], i));
+            std::sort(sorted.begin(), sorted.end());
+
+            std::vector<bool> keep(leaves.size(), false);
+            for (size_t i = 0; i < sorted.size(); ) {
+                size_t j = i;
+                while (j < sorted.size() && sorted[j].first == sorted[i].first)
+                    j++;
+
+                /* The first copy is always the first in the sorted
+                 * run, as ties are sorted by position. */
+                if (idempotent == true || (j - i) % 2 == 1)
+                    keep[sorted[i].second] = true;
+                i = j;
+            }
+
+            std::vector<node_id> out;
+            for (size_t i = 0; i < leaves.size(); ++i)
+                if (keep[i] == true)
+                    out.push_back(leaves[i]);
+            return out;
+        }
+
+    /* Applies a planned rewrite to the graph.  The root's operation is
+     * replaced by the new tree, and whatever was only there to feed
+     * the old tree is removed. */
+    void fill(libpass::dense_graph& graph, const rewrite& r) const
+        {
+            node_id root = graph.dest(r.root);
+
+            std::vector<node_id> temps;
+            if (r.steps.size() > 1) {
+                temps.reserve(r.steps.size() - 1);
+                for (size_t i = 0; i + 1 < r.steps.size(); ++i)
+                    temps.push_back(graph.add_temp(root));
+            }
+
+            auto resolve = [&](const planned_node& n) -> node_id
+                {
+                    if (n.existing != libpass::dense_graph::none)
+                        return n.existing;
+                    return temps[n.temp];
+                };
+
+            std::vector<node_id> old(graph.sources_begin(r.root),
+                                     graph.sources_end(r.root));
+            graph.erase_op(r.root);
+
+            if (r.zero == true)
+                graph.add_op(root, libflo::opcode::MOV,
+                             {graph.add_const("0", graph.width(root))});
+            else if (r.steps.size() == 0)
+                graph.add_op(root, libflo::opcode::MOV, {resolve(r.only)});
+
+            for (size_t i = 0; i < r.steps.size(); ++i) {
+                const auto& s = r.steps[i];
+                node_id d = (i + 1 == r.steps.size()) ? root : temps[i];
+                graph.add_op(d, _opcode, {resolve(s.a), resolve(s.b)});
+            }
+
+            /* The old tree's internal operations were only read by
+             * the old tree, so they can all go now. */
+            while (old.size() > 0) {
+                node_id n = old.back();
+                old.pop_back();
+
+                op_id def = graph.def(n);
+                if (def == libpass::dense_graph::none)
+                    continue;
+                if (is_tree_op(graph, def) == false || graph.use_count(n) != 0)
+                    continue;
 
-                /* There's exactly one node remaining in the input
-                 * set, which is actually the node that should be
-                 * output.  Note that it's fine to emit this MOV here
-                 * as we'll just be getting rid of it later in a
-                 * special pass. */
-                /* FIXME: Actually implement MOV elision. */
-                auto mov_op = std::make_shared<operation>(
-                    op->d(),
-                    op->d()->width(),
-                    libflo::opcode::MOV,
-                    std::vector<node_ptr>({input_set.front()})
-                    );
-                to_fill->add_op(mov_op);
+                old.insert(old.end(),
+                           graph.sources_begin(def),
+                           graph.sources_end(def));
+                graph.erase_op(def);
             }
         }
 };
@@ -191,7 +404,10 @@ private:
 void init(void)
 {
     std::vector<libflo::opcode> opcodes = {libflo::opcode::AND,
-                                           libflo::opcode::OR};
+                                           libflo::opcode::OR,
+                                           libflo::opcode::XOR,
+                                           libflo::opcode::ADD,
+                                           libflo::opcode::MUL};
 
     for (const auto& opcode: opcodes) {
         auto pass = std::make_shared<balance_bitwise_op>(opcode);
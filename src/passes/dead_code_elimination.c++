@@ -22,7 +22,7 @@
 #include <pass.h++>
 #include <pass_list.h++>
 #include <libflo/opcode.h++>
-#include <unordered_map>
+#include <libpass/dense_graph.h++>
 #include <queue>
 
 typedef std::shared_ptr<node> node_ptr;
@@ -31,7 +31,7 @@ typedef std::shared_ptr<flo> flo_ptr;
 
 static void init(void) __attribute__((constructor));
 
-class dead_code_elimination: public pass {
+class dead_code_elimination: public in_place_pass {
 private:
     const std::string _name;
 
@@ -46,56 +46,68 @@ public:
             return _name;
         }
 
-    const flo_ptr operate(const flo_ptr& input) const
+    bool operate_in_place(libpass::dense_graph& graph) const
         {
-            std::unordered_map<node_ptr, bool> emitted;
-            auto out = flo::empty();
+            typedef libpass::dense_graph::node_id node_id;
+            typedef libpass::dense_graph::op_id op_id;
 
-            /* Build a map from nodes to the operation that emits
-             * them. */
-            std::unordered_map<node_ptr, operation_ptr> node2op;
-            for (const auto& op: input->operations())
-                node2op[op->d()] = op;
+            std::vector<bool> emitted(graph.node_count(), false);
+            std::vector<bool> live(graph.op_count(), false);
 
             /* Find every node in the system  */
-            for (const auto& check_op: input->operations()) {
-                if (check_op->op() != libflo::opcode::OUT)
+            for (op_id check_op = 0; check_op < graph.op_count(); ++check_op) {
+                if (graph.is_live(check_op) == false)
+                    continue;
+                if (graph.opcode(check_op) != libflo::opcode::OUT)
                     continue;
 
-                std::queue<operation_ptr> queue({check_op});
+                std::queue<op_id> queue({check_op});
                 while (queue.size() > 0) {
                     auto op = queue.front(); queue.pop();
 
-                    auto emit = [&](const node_ptr& to_emit) -> void
+                    auto emit = [&](node_id to_emit) -> void
                         {
-                            if (to_emit->is_const())
+                            if (graph.is_const(to_emit))
                                 return;
 
-                            auto l = emitted.find(to_emit);
-                            if (l != emitted.end())
+                            if (emitted[to_emit] == true)
                                 return;
 
                             emitted[to_emit] = true;
 
-                            auto nl = node2op.find(to_emit);
-                            if (nl == node2op.end()) {
+                            auto def = graph.def(to_emit);
+                            if (def == libpass::dense_graph::none) {
                                 fprintf(stderr, "Unable to lookup node '%s'\n",
-                                        to_emit->name().c_str()
+                                        graph.name(to_emit)
                                     );
                                 abort();
                             }
 
-                            out->add_op(nl->second);
-                            queue.push(nl->second);
+                            live[def] = true;
+                            queue.push(def);
                         };
 
-                    emit(op->d());
-                    for (const auto& source: op->sources())
-                        emit(source);
+                    emit(graph.dest(op));
+                    for (auto it = graph.sources_begin(op);
+                         it != graph.sources_end(op);
+                         ++it)
+                        emit(*it);
                 }
             }
 
-            return out;
+            /* Everything that wasn't reached is dead.  This includes
+             * operations that write a node that's also written by a
+             * later operation. */
+            bool changed = false;
+            for (op_id op = 0; op < graph.op_count(); ++op) {
+                if (graph.is_live(op) == false || live[op] == true)
+                    continue;
+
+                graph.erase_op(op);
+                changed = true;
+            }
+
+            return changed;
         }
 };
 
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <pass.h++>
+#include <pass_list.h++>
+#include <libflo/opcode.h++>
+#include <libpass/dense_graph.h++>
+#include <vector>
+#include <stdio.h>
+
+static void init(void) __attribute__((constructor));
+
+/* Re-orders the operations in a design so that values tend to be
+ * read soon after they're written, which keeps the node state of the
+ * generated emulator in cache.  The output is still a topological
+ * order: every operation comes after the operations that compute
+ * its combinational inputs, and the operations on each memory stay
+ * in their original order.  Registers don't constrain the order, as
+ * their readers see the value from the previous cycle.  Nothing is
+ * computed any differently, so this only changes the graph's
+ * emission order. */
+class locality_schedule: public in_place_pass {
+private:
+    const std::string _name;
+
+    typedef libpass::dense_graph::node_id node_id;
+    typedef libpass::dense_graph::op_id op_id;
+
+public:
+    locality_schedule(void)
+        : _name("locality_schedule")
+        {
+        }
+
+    const std::string& name(void) const
+        {
+            return _name;
+        }
+
+    bool operate_in_place(libpass::dense_graph& graph) const
+        {
+            /* Everything below that talks about the "original" order
+             * means the order the graph would currently be emitted
+             * in. */
+            auto original = graph.emission_order();
+
+            /* Every memory's operations, in their original order. */
+            pass_timer dep_timer("dependencies");
+            std::vector<uint32_t> mem_offset(graph.node_count() + 1, 0);
+            for (const auto& o: original)
+                for (auto it = graph.sources_begin(o); it != graph.sources_end(o); ++it)
+                    if (graph.is_mem(*it))
+                        mem_offset[*it + 1]++;
+            for (size_t i = 1; i < mem_offset.size(); ++i)
+                mem_offset[i] += mem_offset[i - 1];
+
+            std::vector<op_id> mem_ops(mem_offset.back());
+            std::vector<uint32_t> fill(mem_offset.begin(), mem_offset.end() - 1);
+            for (const auto& o: original)
+                for (auto it = graph.sources_begin(o); it != graph.sources_end(o); ++it)
+                    if (graph.is_mem(*it))
+                        mem_ops[fill[*it]++] = o;
+
+            /* Builds the list of operations that depend on every
+             * operation, stored contiguously like the graph's own
+             * operands are. */
+            std::vector<uint32_t> succ_offset(graph.op_count() + 1, 0);
+            std::vector<uint32_t> pending(graph.op_count(), 0);
+            for_each_dependency(graph, original, mem_offset, mem_ops,
+                                [&](op_id d, op_id o)
+                                {
+                                    succ_offset[d + 1]++;
+                                    pending[o]++;
+                                });
+            for (size_t i = 1; i < succ_offset.size(); ++i)
+                succ_offset[i] += succ_offset[i - 1];
+
+            std::vector<op_id> succ(succ_offset.back());
+            fill.assign(succ_offset.begin(), succ_offset.end() - 1);
+            for_each_dependency(graph, original, mem_offset, mem_ops,
+                                [&](op_id d, op_id o)
+                                {
+                                    succ[fill[d]++] = o;
+                                });
+            dep_timer.stop();
+
+            /* The schedule itself is a topological sort that always
+             * prefers the operations that were most recently made
+             * ready, which means that consumers get placed right
+             * after their last producer (and the operations on a
+             * memory tend to stay together).  When there's nothing
+             * nearby left to do, the next ready operation in the
+             * original order is picked up. */
+            pass_timer sched_timer("schedule");
+            std::vector<op_id> order;
+            order.reserve(original.size());
+            std::vector<bool> scheduled(graph.op_count(), false);
+            std::vector<op_id> stack;
+            size_t cold = 0;
+
+            while (true) {
+                if (stack.size() == 0) {
+                    while (cold < original.size()) {
+                        op_id o = original[cold];
+                        if (!scheduled[o] && pending[o] == 0)
+                            break;
+                        cold++;
+                    }
+
+                    if (cold == original.size())
+                        break;
+                    stack.push_back(original[cold]);
+                }
+
+                op_id o = stack.back();
+                stack.pop_back();
+                if (scheduled[o] == true)
+                    continue;
+
+                scheduled[o] = true;
+                order.push_back(o);
+
+                /* Successors are pushed in reverse so the one that
+                 * came first in the original order goes first. */
+                for (size_t i = succ_offset[o + 1]; i > succ_offset[o]; --i) {
+                    op_id s = succ[i - 1];
+                    if (--pending[s] == 0)
+                        stack.push_back(s);
+                }
+            }
+
+            /* Anything that's left is part of a combinational loop,
+             * which can't be sorted, so it just stays in its
+             * original order. */
+            if (order.size() < original.size()) {
+                fprintf(stderr, "WARNING: combinational loop found while scheduling\n");
+                for (const auto& o: original)
+                    if (!scheduled[o])
+                        order.push_back(o);
+            }
+            sched_timer.stop();
+
+            if (order == original)
+                return false;
+
+            graph.set_order(order);
+            return true;
+        }
+
+private:
+    /* Calls "f(d, o)" for every pair of operations where "d" must be
+     * scheduled before "o".  That's every combinational input, along
+     * with every pair of consecutive operations on the same memory:
+     * the order of reads and writes to a memory within a cycle is
+     * visible to the emulator, so it can't change.  Pairs are listed
+     * in the original order of "o". */
+    template<class F>
+    static void for_each_dependency(const libpass::dense_graph& graph,
+                                    const std::vector<op_id>& original,
+                                    const std::vector<uint32_t>& mem_offset,
+                                    const std::vector<op_id>& mem_ops,
+                                    F f)
+        {
+            for (const auto& o: original) {
+                for (auto it = graph.sources_begin(o); it != graph.sources_end(o); ++it) {
+                    op_id d = producer(graph, *it, o);
+                    if (d != libpass::dense_graph::none)
+                        f(d, o);
+                }
+            }
+
+            for (node_id m = 0; m < graph.node_count(); ++m) {
+                for (size_t i = mem_offset[m] + 1; i < mem_offset[m + 1]; ++i)
+                    if (mem_ops[i - 1] != mem_ops[i])
+                        f(mem_ops[i - 1], mem_ops[i]);
+            }
+        }
+
+    /* Returns the operation that must run before "user" because it
+     * computes "n", or "none" if there isn't one. */
+    static op_id producer(const libpass::dense_graph& graph,
+                          node_id n,
+                          op_id user)
+        {
+            op_id d = graph.def(n);
+            if (d == libpass::dense_graph::none || d == user)
+                return libpass::dense_graph::none;
+            if (graph.opcode(d) == libflo::opcode::REG)
+                return libpass::dense_graph::none;
+            return d;
+        }
+};
+
+void init(void)
+{
+    std::vector<pass_number> passes = {pass_number::SCHEDULE};
+
+    for (const auto &pass_number: passes) {
+        auto pass = std::make_shared<locality_schedule>();
+        pass_list_add(pass, pass_number);
+    }
+}
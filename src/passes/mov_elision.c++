@@ -22,7 +22,6 @@
 #include <pass.h++>
 #include <pass_list.h++>
 #include <libflo/opcode.h++>
-#include <unordered_map>
 
 typedef std::shared_ptr<node> node_ptr;
 typedef std::shared_ptr<operation> operation_ptr;
@@ -30,7 +29,7 @@ typedef std::shared_ptr<flo> flo_ptr;
 
 static void init(void) __attribute__((constructor));
 
-class mov_elision: public pass {
+class mov_elision: public in_place_pass {
 private:
     const std::string _name;
 
@@ -45,44 +44,35 @@ public:
             return _name;
         }
 
-    const flo_ptr operate(const flo_ptr& input) const
+    /* Every MOV is removed each time this runs, so there's only
+     * more to do once a new one shows up. */
+    bool depends_on(const libpass::dense_graph& graph,
+                    libpass::dense_graph::op_id op) const
         {
-            /* Build a map that contains the new node that replaces
-             * each input node. */
-            std::unordered_map<node_ptr, node_ptr> target;
-            for (const auto& op: input->operations()) {
-                if (op->op() != libflo::opcode::MOV)
-                    continue;
+            return graph.opcode(op) == libflo::opcode::MOV;
+        }
 
-                target[op->d()] = op->s();
-            }
+    bool operate_in_place(libpass::dense_graph& graph) const
+        {
+            typedef libpass::dense_graph::op_id op_id;
 
-            /* Rewrite every operation to eliminate the output of MOV
-             * operations. */
-            auto out = flo::empty();
-            for (const auto& op: input->operations()) {
-                if (op->op() == libflo::opcode::MOV)
+            /* Every reader of a MOV's output is pointed at the MOV's
+             * input instead, at which point the MOV itself can go.
+             * Chains of MOVs collapse completely, as the readers of a
+             * later MOV get moved along as each one is removed. */
+            bool changed = false;
+            for (op_id op = 0; op < graph.op_count(); ++op) {
+                if (graph.is_live(op) == false)
+                    continue;
+                if (graph.opcode(op) != libflo::opcode::MOV)
                     continue;
 
-                std::vector<node_ptr> sv;
-                for (const auto& source: op->sources()) {
-                    auto l = target.find(source);
-                    if (l == target.end())
-                        sv.push_back(source);
-                    else
-                        sv.push_back(l->second);
-                }
-
-                auto nop = std::make_shared<operation>(
-                    op->d(),
-                    op->d()->width(),
-                    op->op(),
-                    sv
-                    );
-                out->add_op(nop);
+                graph.replace_all_uses(graph.dest(op), graph.source(op, 0));
+                graph.erase_op(op);
+                changed = true;
             }
 
-            return out;
+            return changed;
         }
 };
 
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-opt.
+ *
+ * flo-opt is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-opt is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-opt.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <pass.h++>
+#include <pass_list.h++>
+#include <libflo/opcode.h++>
+#include <libpass/logic_depth.h++>
+#include <unordered_map>
+#include <deque>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+
+typedef libpass::dense_graph::node_id node_id;
+typedef libpass::dense_graph::op_id op_id;
+
+static void init(void) __attribute__((constructor));
+
+/* Everything that identifies the value an operation computes: two
+ * operations with the same key always produce the same value. */
+struct value_key {
+    libflo::opcode op;
+    size_t width;
+    size_t count;
+    node_id sources[3];
+
+    bool operator==(const value_key& o) const
+        {
+            if (op != o.op || width != o.width || count != o.count)
+                return false;
+            for (size_t i = 0; i < count; ++i)
+                if (sources[i] != o.sources[i])
+                    return false;
+            return true;
+        }
+};
+
+struct value_key_hash {
+    size_t operator()(const value_key& k) const
+        {
+            size_t h = (size_t)k.op * 0x9e3779b97f4a7c15ULL;
+            h ^= k.width + 0x9e3779b9 + (h << 6) + (h >> 2);
+            for (size_t i = 0; i < k.count; ++i)
+                h ^= k.sources[i] + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+};
+
+/* Hash-conses operations: any operation that computes the same
+ * function of the same sources as an earlier one is replaced by that
+ * earlier one, and operations whose sources are all constants are
+ * replaced by their result.  Registers are treated like any other
+ * operation here, so registers that are fed by the same logic get
+ * merged, and that in turn lets the logic after them be merged once
+ * it's requeued. */
+class value_numbering: public in_place_pass {
+private:
+    const std::string _name;
+
+public:
+    value_numbering(void)
+        : _name("value_numbering")
+        {
+        }
+
+    const std::string& name(void) const
+        {
+            return _name;
+        }
+
+    bool operate_in_place(libpass::dense_graph& graph) const
+        {
+            /* Operations are first visited in order of their logic
+             * depth, which means the sources of an operation have
+             * usually been numbered by the time it's looked at.  This
+             * is just a counting sort, so it's linear. */
+            libpass::logic_depth depth(graph);
+            std::vector<size_t> bucket(depth.max() + 2, 0);
+            for (op_id op = 0; op < graph.op_count(); ++op)
+                if (graph.is_live(op))
+                    bucket[depth.depth(graph.dest(op)) + 1]++;
+            for (size_t i = 1; i < bucket.size(); ++i)
+                bucket[i] += bucket[i - 1];
+
+            std::deque<op_id> worklist(graph.live_op_count());
+            for (op_id op = 0; op < graph.op_count(); ++op)
+                if (graph.is_live(op))
+                    worklist[bucket[depth.depth(graph.dest(op))]++] = op;
+
+            /* Every operation is on the worklist at most once, but
+             * when one is merged away everything that read it has
+             * new sources, so those readers get looked at again.
+             * Each merge erases an operation, so this terminates
+             * without ever re-walking the whole graph. */
+            std::vector<bool> queued(graph.op_count(), true);
+
+            state s;
+            s.values.reserve(worklist.size());
+
+            bool changed = false;
+            while (worklist.size() > 0) {
+                op_id op = worklist.front();
+                worklist.pop_front();
+                queued[op] = false;
+
+                if (graph.is_live(op) == false)
+                    continue;
+                if (numberable(graph.opcode(op)) == false)
+                    continue;
+                if (graph.source_count(op) > 3)
+                    continue;
+
+                node_id dest = graph.dest(op);
+
+                /* Operations on nothing but constants can be
+                 * computed right now. */
+                std::string folded;
+                if (fold(graph, op, folded) == true) {
+                    node_id k = graph.add_const(folded, graph.width(dest));
+                    merge(graph, s, op, k, worklist, queued);
+                    changed = true;
+                    continue;
+                }
+
+                auto key = key_of(graph, op);
+                auto l = s.values.find(key);
+                if (l == s.values.end()) {
+                    s.values[key] = op;
+                    continue;
+                }
+
+                /* There's already an operation that computes this
+                 * exact value, so everything that reads this one can
+                 * read that one instead. */
+                if (l->second == op)
+                    continue;
+
+                merge(graph, s, op, graph.dest(l->second), worklist, queued);
+                changed = true;
+            }
+
+            return changed;
+        }
+
+private:
+    /* Everything that's been numbered so far.  Constants don't need
+     * to be tracked here, as the graph already gives every constant
+     * with the same value and width the same ID. */
+    struct state {
+        std::unordered_map<value_key, op_id, value_key_hash> values;
+    };
+
+    static value_key key_of(const libpass::dense_graph& graph, op_id op)
+        {
+            node_id dest = graph.dest(op);
+
+            value_key key;
+            key.op = graph.opcode(op);
+            key.width = graph.known_width(dest) ? graph.width(dest) : 0;
+            key.count = graph.source_count(op);
+            for (size_t i = 0; i < key.count; ++i)
+                key.sources[i] = graph.source(op, i);
+            if (commutative(key.op) && key.sources[0] > key.sources[1]) {
+                node_id t = key.sources[0];
+                key.sources[0] = key.sources[1];
+                key.sources[1] = t;
+            }
+            return key;
+        }
+
+    /* Replaces the value computed by "op" with "to" and erases "op".
+     * The operations that read it are about to change their sources,
+     * so they're dropped from the table under their old keys and
+     * queued up to be numbered again. */
+    static void merge(libpass::dense_graph& graph,
+                      state& s,
+                      op_id op,
+                      node_id to,
+                      std::deque<op_id>& worklist,
+                      std::vector<bool>& queued)
+        {
+            node_id dest = graph.dest(op);
+
+            for (const auto& user: graph.uses(dest)) {
+                if (user == op || queued[user] == true)
+                    continue;
+
+                if (numberable(graph.opcode(user)) &&
+                    graph.source_count(user) <= 3) {
+                    auto l = s.values.find(key_of(graph, user));
+                    if (l != s.values.end() && l->second == user)
+                        s.values.erase(l);
+                }
+
+                queued[user] = true;
+                worklist.push_back(user);
+            }
+
+            graph.replace_all_uses(dest, to);
+            graph.erase_op(op);
+        }
+
+    /* Returns TRUE for operations that are a pure function of their
+     * sources (or, for registers, of their sources on the previous
+     * cycle). */
+    static bool numberable(const libflo::opcode& op)
+        {
+            switch (op) {
+            case libflo::opcode::ADD:
+            case libflo::opcode::AND:
+            case libflo::opcode::ARSH:
+            case libflo::opcode::CAT:
+            case libflo::opcode::EQ:
+            case libflo::opcode::GTE:
+            case libflo::opcode::LOG2:
+            case libflo::opcode::LSH:
+            case libflo::opcode::LT:
+            case libflo::opcode::MOV:
+            case libflo::opcode::MUL:
+            case libflo::opcode::MUX:
+            case libflo::opcode::NEG:
+            case libflo::opcode::NEQ:
+            case libflo::opcode::NOT:
+            case libflo::opcode::OR:
+            case libflo::opcode::REG:
+            case libflo::opcode::RSH:
+            case libflo::opcode::SUB:
+            case libflo::opcode::XOR:
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+    static bool commutative(const libflo::opcode& op)
+        {
+            switch (op) {
+            case libflo::opcode::ADD:
+            case libflo::opcode::AND:
+            case libflo::opcode::EQ:
+            case libflo::opcode::MUL:
+            case libflo::opcode::NEQ:
+            case libflo::opcode::OR:
+            case libflo::opcode::XOR:
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+    /* Parses the value of a constant node, which is just its name.
+     * Anything that isn't a plain decimal number that fits in 64 bits
+     * is left alone. */
+    static bool const_value(const libpass::dense_graph& graph,
+                            node_id n,
+                            uint64_t& value)
+        {
+            if (graph.is_const(n) == false || graph.name(n) == NULL)
+                return false;
+
+            const char *name = graph.name(n);
+            if (*name < '0' || *name > '9')
+                return false;
+
+            char *end;
+            errno = 0;
+            value = strtoull(name, &end, 10);
+            return (*end == '\0') && (errno == 0);
+        }
+
+    /* Tries to compute the result of an operation whose sources are
+     * all constant, writing it out as the name of a constant node. */
+    static bool fold(const libpass::dense_graph& graph,
+                     op_id op,
+                     std::string& out)
+        {
+            node_id dest = graph.dest(op);
+            if (graph.known_width(dest) == false || graph.width(dest) > 64)
+                return false;
+
+            uint64_t v[2];
+            size_t count = graph.source_count(op);
+            if (count < 1 || count > 2)
+                return false;
+            for (size_t i = 0; i < count; ++i)
+                if (const_value(graph, graph.source(op, i), v[i]) == false)
+                    return false;
+
+            size_t width = graph.width(dest);
+            uint64_t mask = (width == 64) ? ~0ULL : ((1ULL << width) - 1);
+            uint64_t r;
+
+            if (count == 1) {
+                switch (graph.opcode(op)) {
+                case libflo::opcode::NOT: r = ~v[0];  break;
+                default: return false;
+                }
+            } else {
+                switch (graph.opcode(op)) {
+                case libflo::opcode::ADD: r = v[0] + v[1];  break;
+                case libflo::opcode::SUB: r = v[0] - v[1];  break;
+                case libflo::opcode::MUL: r = v[0] * v[1];  break;
+                case libflo::opcode::AND: r = v[0] & v[1];  break;
+                case libflo::opcode::OR:  r = v[0] | v[1];  break;
+                case libflo::opcode::XOR: r = v[0] ^ v[1];  break;
+                case libflo::opcode::EQ:  r = v[0] == v[1]; break;
+                case libflo::opcode::NEQ: r = v[0] != v[1]; break;
+                case libflo::opcode::LT:  r = v[0] < v[1];  break;
+                case libflo::opcode::GTE: r = v[0] >= v[1]; break;
+                case libflo::opcode::LSH: r = (v[1] < 64) ? (v[0] << v[1]) : 0; break;
+                case libflo::opcode::RSH: r = (v[1] < 64) ? (v[0] >> v[1]) : 0; break;
+                default: return false;
+                }
+            }
+
+            out = std::to_string((unsigned long long)(r & mask));
+            return true;
+        }
+};
+
+void init(void)
+{
+    std::vector<pass_number> passes = {pass_number::GVN};
+
+    for (const auto &pass_number: passes) {
+        auto pass = std::make_shared<value_numbering>();
+        pass_list_add(pass, pass_number);
+    }
+}
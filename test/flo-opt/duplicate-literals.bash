@@ -0,0 +1,24 @@
+#include "tempdir.bash"
+
+set -ex
+set -o pipefail
+
+# Operations that only differ by which copy of a literal they read
+# compute the same value, which includes registers written the way
+# Chisel emits them.
+cat > in.flo <<EOF
+a = in'8
+x = add'8 a 1
+z = add'8 a 1
+P = reg'8 1 x
+Q = reg'8 1 z
+ox = out'8 P
+oz = out'8 Q
+EOF
+cat in.flo
+
+$PTEST_BINARY in.flo out.flo
+cat out.flo
+
+test "$(grep -c "= add'8 a 1$" out.flo)" == 1
+test "$(grep -c "= reg'8 1 " out.flo)" == 1
@@ -38,6 +38,10 @@ then
     diff Torture-vg.flo Torture.flo
 fi
 
+# Running passes on more than one thread must not change the output
+$PTEST_BINARY -j 4 Torture-unopt.flo Torture-j4.flo
+diff Torture-j4.flo Torture.flo
+
 # Build that Flo output into a C++ emulator
 flo-llvm --torture Torture.flo
 
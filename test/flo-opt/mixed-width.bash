@@ -0,0 +1,30 @@
+#include "tempdir.bash"
+
+set -ex
+set -o pipefail
+
+# Extract the operation to test from the name of the test
+testname="$(basename "$(dirname "$0")")"
+op="$(echo "$testname" | rev | cut -d- -f1 | rev)"
+
+# A tree with a narrow node in the middle, which truncates "a" and
+# "b" before they're combined with anything else.
+cat > in.flo <<EOF
+a = in'8
+b = in'8
+c = in'8
+d = in'8
+t = $op'4 a b
+u = $op'8 t c
+v = $op'8 u d
+o = out'8 v
+EOF
+cat in.flo
+
+$PTEST_BINARY in.flo out.flo
+cat out.flo
+
+# "a" and "b" must still be combined at the narrow width, and nowhere
+# else.
+test "$(grep -c "= $op'4 a b$" out.flo)" == 1
+test "$(grep "= $op'8 " out.flo | tr ' ' '\n' | grep -c "^[ab]$" || true)" == 0
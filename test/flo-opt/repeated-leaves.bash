@@ -0,0 +1,49 @@
+#include "tempdir.bash"
+
+set -ex
+set -o pipefail
+
+# Extract the operation to test from the name of the test
+testname="$(basename "$(dirname "$0")")"
+op="$(echo "$testname" | rev | cut -d- -f1 | rev)"
+
+# A tree that reads "a" twice, which is only allowed to be merged
+# into a single input for some operations.
+cat > in.flo <<EOF
+a = in'8
+b = in'8
+c = in'8
+t = $op'8 a b
+u = $op'8 t a
+v = $op'8 u c
+o = out'8 v
+EOF
+cat in.flo
+
+$PTEST_BINARY in.flo out.flo
+cat out.flo
+
+# Count how many times "a" is still an input to the tree.
+reads="$(grep "= $op'8 " out.flo | tr ' ' '\n' | grep -c "^a$" || true)"
+
+case "$op" in
+and|or)
+    # Idempotent, so "a" only needs to be read once.
+    test "$reads" == 1
+    ;;
+xor)
+    # The two copies of "a" cancel out.
+    test "$reads" == 0
+    ;;
+add|mul)
+    # Both copies of "a" are needed.
+    test "$reads" == 2
+    ;;
+*)
+    exit 1
+    ;;
+esac
+
+# "b" and "c" are each read exactly once by every operation.
+test "$(grep "= $op'8 " out.flo | tr ' ' '\n' | grep -c "^b$")" == 1
+test "$(grep "= $op'8 " out.flo | tr ' ' '\n' | grep -c "^c$")" == 1